@@ -0,0 +1,39 @@
+#ifndef LINEARWANG_BENCH_H
+#define LINEARWANG_BENCH_H
+
+#include <chrono>
+#include <sys/resource.h>
+#include "board.h"
+#include "coloring.h"
+
+// Helpers shared by the benchmarks.
+
+inline std::chrono::steady_clock::time_point now() {
+    return std::chrono::steady_clock::now();
+}
+
+inline double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(now() - start).count();
+}
+
+// Peak resident set size of the process, in MiB.
+inline double peak_rss_mib() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_maxrss) / 1024.0;
+}
+
+// Colors the boundary and the exterior of the board as the program does.
+inline Coloring exterior_coloring(Board& board) {
+    Coloring coloring(board.width(), board.height());
+    board.edge_iter([&board, &coloring](Edge e) { if (board.is_boundary_edge(e)) set_color(coloring, e, 0); });
+    board.outside_vertex_iter([&coloring](coord_type v){
+        set_color(coloring, left(v), 1);
+        set_color(coloring, right(v), 1);
+        set_color(coloring, top(v), v.second % 2 == 0 ? 0 : 2);
+        set_color(coloring, bottom(v), v.second % 2 == 0 ? 2 : 0);
+    });
+    return coloring;
+}
+
+#endif //LINEARWANG_BENCH_H
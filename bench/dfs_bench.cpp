@@ -0,0 +1,58 @@
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "bench.h"
+#include "cell_graph.h"
+#include "general.h"
+
+// Time per cell of find_cycle_by_dfs on combs of 10^3 to 10^8 cells (or up to the count
+// given as argument) whose only cycles close at the foot of the spine, so the search visits
+// every tooth first. The stack stays as short as the spine plus one tooth.
+
+namespace {
+
+// Teeth along every other row, a spine on their right and a 2x2 block at its foot.
+Board comb(int length, int height, Component& component) {
+    Board board(static_cast<size_t>(length + 2), static_cast<size_t>(height));
+    for (int j = 0; j < height; j += 2)
+        for (int i = 0; i < length; ++i)
+            board.add_cell(i, j);
+    for (int j = 0; j < height; ++j)
+        board.add_cell(length, j);
+    board.add_cell(length + 1, 0);
+    board.add_cell(length + 1, 1);
+
+    component.id = 0;
+    component.seed = std::make_pair(0, 0);
+    component.low = std::make_pair(0, 0);
+    component.high = std::make_pair(length + 1, height - 1);
+    component.origin = std::make_pair(0, 0);
+    return board;
+}
+
+}
+
+int main(int argc, char** argv) {
+    double limit = argc > 1 ? std::atof(argv[1]) : 1e8;
+    std::cout<<"cells  search (s)  ns/cell\n";
+    for (double target = 1e3; target <= limit; target *= 10) {
+        // About height^2 cells, with teeth twice as long as the spine.
+        int height = 2;
+        while (static_cast<double>(height) * height < target)
+            height += 2;
+        int length = 2 * height;
+        Component component;
+        Board board = comb(length, height, component);
+        CellGraph graph(board);
+        size_t cells = static_cast<size_t>(height / 2) * static_cast<size_t>(length) + static_cast<size_t>(height) + 2;
+
+        std::vector<coord_type> cycle;
+        auto start = now();
+        find_cycle_by_dfs(board, graph, component.seed, cycle);
+        double seconds = seconds_since(start);
+
+        std::cout<<cells<<"  "<<seconds<<"  "<<seconds / static_cast<double>(cells) * 1e9
+                 <<" (cycle of "<<cycle.size()<<" cells)\n";
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include "bench.h"
+
+// Cost of probing the four sides of every cell on a board where one edge in a hundred is
+// colored, as the tree solver and get_tile do: through std::map::at and an exception for
+// uncolored edges, as the solver used to, through the map with a sentinel, and through the
+// dense planes.
+
+namespace {
+
+const int side = 1024;
+const int rounds = 8;
+
+int throwing_lookup(const std::map<Edge, int, EdgeLess>& colors, Edge e) {
+    try {
+        return colors.at(e);
+    } catch (const std::out_of_range&) {
+        return UNCOLORED;
+    }
+}
+
+template<typename Lookup>
+void measure(const char* name, const Lookup& lookup) {
+    long checksum = 0;
+    auto start = now();
+    for (int round = 0; round < rounds; ++round)
+        for (int j = 0; j < side; ++j)
+            for (int i = 0; i < side; ++i)
+                for (auto e: adjacent_edges(std::make_pair(i, j)))
+                    checksum += lookup(e);
+    double lookups = 4.0 * side * side * rounds;
+    std::cout<<name<<": "<<seconds_since(start) / lookups * 1e9<<" ns per lookup (checksum "<<checksum<<")\n";
+}
+
+}
+
+int main() {
+    MapColoring map(side, side);
+    DenseColoring dense(side, side);
+
+    std::mt19937 rng(1234);
+    std::bernoulli_distribution colored(0.01);
+    for (int j = 0; j < side; ++j) {
+        for (int i = 0; i < side; ++i) {
+            for (auto e: {top(std::make_pair(i, j)), right(std::make_pair(i, j))}) {
+                if (colored(rng)) {
+                    set_color(map, e, 1);
+                    set_color(dense, e, 1);
+                }
+            }
+        }
+    }
+
+    std::cout<<side<<"x"<<side<<" board, "<<map.colors.size()<<" colored edges\n";
+    measure("map, at and exception", [&map](Edge e) { return throwing_lookup(map.colors, e); });
+    measure("map, sentinel", [&map](Edge e) { return lookup_color(map, e); });
+    measure("dense planes", [&dense](Edge e) { return lookup_color(dense, e); });
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "bench.h"
+#include "general.h"
+
+// Solves masks made of n small rings, each a thin cycle. Every component clears the marks
+// four times: twice while its cell graph is built and twice in find_cycle_by_dfs. With
+// epoch stamps the time per component stays flat as n grows.
+//
+// The second column is a proxy, not a solver path: the solver no longer has a full clear
+// to time. It fills a plane of the board's size with zeros four times per component, which
+// is what clearing a one-bit-per-cell mark plane would cost, and grows with the area.
+
+namespace {
+
+// Rings of 3x3 cells around a hole, on a grid of pitch 4.
+Board rings(size_t count, size_t& per_row) {
+    per_row = 1;
+    while (per_row * per_row < count)
+        ++per_row;
+    size_t side = 4 * per_row;
+    Board board(side, side);
+    for (size_t k = 0; k < count; ++k) {
+        int i0 = static_cast<int>(4 * (k % per_row));
+        int j0 = static_cast<int>(4 * (k / per_row));
+        for (int j = 0; j < 3; ++j)
+            for (int i = 0; i < 3; ++i)
+                if (i != 1 || j != 1)
+                    board.add_cell(i0 + i, j0 + j);
+    }
+    return board;
+}
+
+}
+
+int main() {
+    std::cout<<"components  solve (us/component)  proxy: 4 full-plane fills (us/component)\n";
+    for (size_t count: {1000, 10000, 100000}) {
+        size_t per_row;
+        Board board = rings(count, per_row);
+        Coloring coloring = exterior_coloring(board);
+        ColorGeneration<3> gen(1234);
+
+        auto start = now();
+        complete_coloring(gen, board, coloring);
+        double solve = seconds_since(start) / static_cast<double>(count);
+
+        // Proxy: four fills of a plane as large as the mark plane per component, timed on a
+        // sample of components.
+        std::vector<uint64_t> plane(board.words_per_row() * board.height());
+        size_t sample = std::min<size_t>(count, 1000);
+        start = now();
+        for (size_t k = 0; k < 4 * sample; ++k) {
+            std::fill(plane.begin(), plane.end(), 0);
+            plane[k % plane.size()] = k;
+        }
+        double clears = seconds_since(start) / static_cast<double>(sample);
+
+        std::cout<<count<<"  "<<solve * 1e6<<"  "<<clears * 1e6<<" (checksum "<<plane[1]<<")\n";
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "wang.h"
+
+// Completes tiles on several threads, each owning its generation, through a reference as
+// the solvers do, and through a handle holding a shared_ptr copied into every call, as the
+// solvers used to take ColorGeneration by value. Every such copy increments and decrements
+// the reference count with atomic instructions.
+
+namespace {
+
+const size_t cells = 1 << 23;
+
+struct SharedHandle {
+    std::shared_ptr<ColorGeneration<3>> gen;
+};
+
+__attribute__((noinline)) int complete_by_reference(ColorGeneration<3>& gen, tile t) {
+    gen.complete_tile(t);
+    return t[1] + t[3];
+}
+
+__attribute__((noinline)) int complete_by_handle(SharedHandle handle, tile t) {
+    handle.gen->complete_tile(t);
+    return t[1] + t[3];
+}
+
+template<typename Work>
+double measure(unsigned threads, const Work& work) {
+    std::vector<std::thread> workers;
+    std::vector<long> checksums(threads);
+    auto start = now();
+    for (unsigned k = 0; k < threads; ++k)
+        workers.emplace_back([&work, &checksums, k]() { checksums[k] = work(k); });
+    for (auto& worker: workers)
+        worker.join();
+    double seconds = seconds_since(start);
+    long checksum = 0;
+    for (auto c: checksums)
+        checksum += c;
+    std::cerr<<"checksum "<<checksum<<"\n";
+    return seconds / static_cast<double>(cells * threads) * 1e9;
+}
+
+}
+
+int main() {
+    std::cout<<"threads  reference (ns/cell)  shared_ptr handle (ns/cell)\n";
+    for (unsigned threads: {1u, 2u, 4u}) {
+        double by_reference = measure(threads, [](unsigned k) {
+            ColorGeneration<3> gen(1234 + k);
+            long sum = 0;
+            for (size_t c = 0; c < cells; ++c)
+                sum += complete_by_reference(gen, tile {{0, -1, 1, -1}});
+            return sum;
+        });
+        double by_handle = measure(threads, [](unsigned k) {
+            SharedHandle handle {std::make_shared<ColorGeneration<3>>(1234 + k)};
+            long sum = 0;
+            for (size_t c = 0; c < cells; ++c)
+                sum += complete_by_handle(handle, tile {{0, -1, 1, -1}});
+            return sum;
+        });
+        std::cout<<threads<<"  "<<by_reference<<"  "<<by_handle<<"\n";
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <iostream>
+#include <string>
+#include "bench.h"
+#include "components.h"
+#include "general.h"
+
+// Peak RSS on a 4096x4096 comb, a single tree of 8.4M cells, through the pipeline of the
+// program. Peak RSS only grows, so each measure runs in a process of its own, selected by
+// the argument:
+//   none     board and exterior coloring only
+//   label    and label_components
+//   solve    solved by complete_coloring, labelling included, as the program does
+//   threads  solved by complete_coloring_parallel on 2 threads, as with --threads 2
+// The solver before the constraint planes is not in the tree; to compare with it, run the
+// program of each revision on a comb mask and read the peak RSS of the process.
+
+namespace {
+
+const int side = 4096;
+
+// A spine along the bottom row and teeth up every other column.
+Board comb() {
+    Board board(side, side);
+    for (int i = 0; i < side; ++i)
+        board.add_cell(i, 0);
+    for (int i = 0; i < side; i += 2)
+        for (int j = 1; j < side; ++j)
+            board.add_cell(i, j);
+    return board;
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string mode = argc > 1 ? argv[1] : "solve";
+    if (mode != "none" && mode != "label" && mode != "solve" && mode != "threads") {
+        std::cout<<"Usage: "<<argv[0]<<" [none|label|solve|threads]\n";
+        return 1;
+    }
+
+    Board board = comb();
+    Coloring coloring = exterior_coloring(board);
+
+    auto start = now();
+    size_t components = 0;
+    if (mode == "label") {
+        components = label_components(board).size();
+    } else if (mode == "solve") {
+        ColorGeneration<3> gen(1234);
+        complete_coloring(gen, board, coloring);
+    } else if (mode == "threads") {
+        complete_coloring_parallel<3>(1234, 2, board, coloring);
+    }
+
+    std::cout<<mode<<": ";
+    if (mode == "label")
+        std::cout<<components<<" components, ";
+    std::cout<<seconds_since(start)<<" s, peak RSS "<<peak_rss_mib()<<" MiB\n";
+    return 0;
+}
@@ -4,9 +4,14 @@
 #include <exception>
 #include <utility>
 #include <vector>
+#include <array>
 #include <map>
 #include <cstdlib>
 #include <set>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <ostream>
 
 typedef std::pair<int, int> coord_type;
 
@@ -53,8 +58,27 @@ inline Edge right(coord_type c){
     return Edge(Orientation::V, c.first, c.second);
 }
 
-inline std::vector<Edge> adjacent_edges(coord_type c){
-    return std::vector<Edge>({top(c), left(c), bottom(c), right(c)});
+inline std::array<Edge, 4> adjacent_edges(coord_type c){
+    return std::array<Edge, 4> {{top(c), left(c), bottom(c), right(c)}};
+}
+
+// Sides are numbered in the order of adjacent_edges: top, left, bottom, right.
+inline Edge side_edge(coord_type c, int side){
+    switch (side) {
+        case 0: return top(c);
+        case 1: return left(c);
+        case 2: return bottom(c);
+        default: return right(c);
+    }
+}
+
+inline coord_type across_side(coord_type c, int side){
+    switch (side) {
+        case 0: return std::make_pair(c.first, c.second+1);
+        case 1: return std::make_pair(c.first-1, c.second);
+        case 2: return std::make_pair(c.first, c.second-1);
+        default: return std::make_pair(c.first+1, c.second);
+    }
 }
 
 inline coord_type first(Edge e) {
@@ -62,14 +86,28 @@ inline coord_type first(Edge e) {
 }
 
 inline coord_type second(Edge e) {
-    switch(e.o){
-        case Orientation::H:
-            return std::make_pair(e.i, e.j+1);
-        case Orientation::V:
-            return std::make_pair(e.i+1, e.j);
-    }
+    if (e.o == Orientation::H)
+        return std::make_pair(e.i, e.j+1);
+    return std::make_pair(e.i+1, e.j);
 }
 
+// At most four cells, stored inline so that neighbor queries do not allocate.
+class CellRange {
+public:
+    CellRange(): m_size(0) {}
+
+    void push_back(coord_type c) { m_cells[m_size++] = c; }
+
+    const coord_type* begin() const { return m_cells.data(); }
+    const coord_type* end() const { return m_cells.data() + m_size; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+private:
+    std::array<coord_type, 4> m_cells;
+    size_t m_size;
+};
+
 class NoEdge: public std::exception {};
 
 inline Edge edge_between(coord_type cin, coord_type cout){
@@ -87,12 +125,22 @@ inline Edge edge_between(coord_type cin, coord_type cout){
     }
 }
 
+// Cells are stored in three bitplanes (polygon membership, DFS marks and tiled state),
+// one bit per cell. Each row is padded to a whole number of 64-bit words so that a row
+// can be scanned, or skipped, a word at a time.
+// Every word of the mark plane carries the epoch in which it was last written and only
+// counts as marked during that epoch, so clean_marks just starts a new epoch.
 class Board {
 public:
     Board(size_t width, size_t height)
             : m_width(width)
             , m_height(height)
-            , m_cells(width * height, 0) {}
+            , m_stride((width + 63) / 64)
+            , m_polygon(m_stride * height, 0)
+            , m_marks(m_stride * height, 0)
+            , m_mark_epochs(m_stride * height, 0)
+            , m_epoch(1)
+            , m_tiled(m_stride * height, 0) {}
 
     size_t to_index(coord_type c) const {
         return m_width * static_cast<size_t>(c.second) + static_cast<size_t>(c.first);
@@ -109,9 +157,8 @@ public:
     }
 
     void add_cell(coord_type c){
-        if (in_boundaries(c)){
-            m_cells[to_index(c)] = 1;
-        }
+        if (in_boundaries(c))
+            m_polygon[word_index(c)] |= bit(c);
     }
 
     void add_cell(int i, int j){
@@ -120,7 +167,7 @@ public:
 
     bool in_polygon(coord_type c) const {
         if (in_boundaries(c))
-            return m_cells[to_index(c)] > 0;
+            return (m_polygon[word_index(c)] & bit(c)) != 0;
         return false;
     }
 
@@ -128,22 +175,26 @@ public:
         return in_polygon(std::make_pair(i, j));
     }
 
-    std::vector<coord_type> neighbors(coord_type c){
-        std::vector<coord_type> n;
-        auto topCell = std::make_pair(c.first, c.second+1);
-        auto leftCell = std::make_pair(c.first-1, c.second);
-        auto bottomCell = std::make_pair(c.first, c.second-1);
-        auto rightCell = std::make_pair(c.first+1, c.second);
+    // Bit s is set when the cell across side s is in the polygon.
+    int neighbor_mask(coord_type c) const {
+        int mask = 0;
+        for (int side = 0; side < 4; ++side){
+            if (in_polygon(across_side(c, side)))
+                mask |= 1 << side;
+        }
+        return mask;
+    }
 
-        if (in_polygon(topCell)) n.push_back(topCell);
-        if (in_polygon(leftCell)) n.push_back(leftCell);
-        if (in_polygon(bottomCell)) n.push_back(bottomCell);
-        if (in_polygon(rightCell)) n.push_back(rightCell);
+    CellRange neighbors(coord_type c) const {
+        CellRange n;
+        int mask = neighbor_mask(c);
+        for (int side = 0; side < 4; ++side){
+            if (mask & (1 << side))
+                n.push_back(across_side(c, side));
+        }
         return n;
     }
 
-
-
     bool is_boundary_edge(Edge e) const {
         auto f = first(e);
         auto s = second(e);
@@ -155,72 +206,125 @@ public:
     }
 
     void mark(coord_type c){
-        if (in_polygon(c) && m_cells[to_index(c)]%2 == 1)
-            m_cells[to_index(c)] += 1;
+        if (in_polygon(c)){
+            size_t w = word_index(c);
+            if (m_mark_epochs[w] != m_epoch){
+                m_mark_epochs[w] = m_epoch;
+                m_marks[w] = 0;
+            }
+            m_marks[w] |= bit(c);
+        }
     }
 
     bool is_marked(coord_type c) const {
         if (in_polygon(c))
-            return m_cells[to_index(c)] % 2 == 0;
+            return (marks(word_index(c)) & bit(c)) != 0;
         return false;
     }
 
     void clean_marks() {
-        for(size_t index = 0; index < m_width * m_height; ++index){
-            if (m_cells[index] > 0 && m_cells[index] % 2 == 0)
-                m_cells[index] -= 1;
+        if (++m_epoch == 0){
+            // The epoch counter wrapped around: stale stamps could become valid again.
+            std::fill(m_mark_epochs.begin(), m_mark_epochs.end(), 0);
+            m_epoch = 1;
         }
     }
 
     void set_to_tiled(coord_type c) {
-        if(in_polygon(c) && m_cells[to_index(c)] < 3){
-            m_cells[to_index(c)] += 2;
-        }
+        if (in_polygon(c))
+            m_tiled[word_index(c)] |= bit(c);
+    }
+
+    void set_all_to_tiled() {
+        m_tiled = m_polygon;
     }
 
     void vertex_iter(std::function<void(coord_type)> f) const {
-        for(size_t index = 0; index < m_width * m_height; ++index){
-            if (m_cells[index] >= 1) f(from_index(index));
+        for (size_t w = 0; w < m_polygon.size(); ++w){
+            for_each_bit(w, m_polygon[w], f);
         }
     }
 
     void outside_vertex_iter(std::function<void(coord_type)> f) const {
-        for(size_t index = 0; index < m_width * m_height; ++index){
-            if (m_cells[index] == 0) f(from_index(index));
+        for (size_t w = 0; w < m_polygon.size(); ++w){
+            for_each_bit(w, ~m_polygon[w] & row_mask(w), f);
         }
     }
 
     void edge_iter(std::function<void(Edge)> f){
-        std::set<Edge, EdgeLess> visited;
-        for(size_t index = 0; index < m_width * m_height; ++index){
-            if (m_cells[index] == 1){
-                for (auto e: adjacent_edges(from_index(index))){
-                    if (visited.count(e) == 0){
-                        f(e);
-                        visited.insert(e);
-                    }
-                }
-            }
+        // An edge shared by two free cells is reported with the first of them in row-major order.
+        for (size_t w = 0; w < m_polygon.size(); ++w){
+            for_each_bit(w, free_cells(w), [this, &f](coord_type c){
+                f(top(c));
+                if (!is_free(std::make_pair(c.first-1, c.second))) f(left(c));
+                if (!is_free(std::make_pair(c.first, c.second-1))) f(bottom(c));
+                f(right(c));
+            });
         }
     }
 
-    class EmptyBoard: public std::exception {};
-
-    coord_type find_a_cell() {
-        for (size_t index = 0; index < m_width * m_height; ++index){
-            if (m_cells[index] == 1)
-                return from_index(index);
-        }
-        throw (EmptyBoard());
-    }
-
     size_t width() const { return m_width; }
     size_t height() const { return m_height; }
 
+    size_t words_per_row() const { return m_stride; }
+
+    // Untiled polygon cells among the 64 cells of row j starting at column 64 * k.
+    uint64_t untiled_word(size_t j, size_t k) const {
+        size_t w = m_stride * j + k;
+        return m_polygon[w] & ~m_tiled[w];
+    }
+
 private:
+    size_t word_index(coord_type c) const {
+        return m_stride * static_cast<size_t>(c.second) + static_cast<size_t>(c.first) / 64;
+    }
+
+    static uint64_t bit(coord_type c) {
+        return uint64_t(1) << (static_cast<unsigned>(c.first) % 64);
+    }
+
+    coord_type cell_at(size_t w, int b) const {
+        return std::make_pair(static_cast<int>((w % m_stride) * 64) + b, static_cast<int>(w / m_stride));
+    }
+
+    // Bits of word w that correspond to actual cells rather than row padding.
+    uint64_t row_mask(size_t w) const {
+        size_t used = m_width - (w % m_stride) * 64;
+        return used >= 64 ? ~uint64_t(0) : (uint64_t(1) << used) - 1;
+    }
+
+    uint64_t marks(size_t w) const {
+        return m_mark_epochs[w] == m_epoch ? m_marks[w] : 0;
+    }
+
+    // Cells of the polygon which are neither marked nor tiled.
+    uint64_t free_cells(size_t w) const {
+        return m_polygon[w] & ~marks(w) & ~m_tiled[w];
+    }
+
+    bool is_free(coord_type c) const {
+        if (!in_boundaries(c))
+            return false;
+        size_t w = word_index(c);
+        return (free_cells(w) & bit(c)) != 0;
+    }
+
+    template<typename F>
+    void for_each_bit(size_t w, uint64_t bits, const F& f) const {
+        while (bits != 0){
+            f(cell_at(w, __builtin_ctzll(bits)));
+            bits &= bits - 1;
+        }
+    }
+
     size_t m_width;
     size_t m_height;
-    std::vector<int> m_cells;
+    size_t m_stride;
+    std::vector<uint64_t> m_polygon;
+    std::vector<uint64_t> m_marks;
+    std::vector<uint32_t> m_mark_epochs;
+    uint32_t m_epoch;
+    std::vector<uint64_t> m_tiled;
 
 };
 
@@ -0,0 +1,95 @@
+#ifndef LINEARWANG_BUFFERED_BITS_H
+#define LINEARWANG_BUFFERED_BITS_H
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include "philox.h"
+
+// Fills out with n words from the engine, two draws per word for 32-bit engines.
+template<typename Engine>
+void fill_words(Engine& engine, uint64_t* out, size_t n) {
+    for (size_t k = 0; k < n; ++k) {
+        if (Engine::max() == std::numeric_limits<uint64_t>::max()) {
+            out[k] = engine();
+        } else {
+            uint64_t low = static_cast<uint32_t>(engine());
+            out[k] = low | (static_cast<uint64_t>(static_cast<uint32_t>(engine())) << 32);
+        }
+    }
+}
+
+inline void fill_words(Philox4x32& engine, uint64_t* out, size_t n) {
+    engine.fill(out, n);
+}
+
+// Random bits drawn a block of words at a time and handed out in small slices. Colors
+// need only two or three bits each, so one engine call feeds many draws instead of one.
+template<typename Engine>
+class BufferedBits {
+public:
+    static const size_t block_words = 8;
+
+    explicit BufferedBits(unsigned seed): m_engine(seed), m_word(block_words), m_bits(0), m_current(0) {}
+    BufferedBits(const Engine& engine): m_engine(engine), m_word(block_words), m_bits(0), m_current(0) {}
+
+    const Engine& engine() const {
+        return m_engine;
+    }
+
+    Engine& engine() {
+        return m_engine;
+    }
+
+    // Uniform in [0, n), by rejection on the fewest bits that can hold n-1.
+    int below(int n) {
+        int bits = 0;
+        while ((1 << bits) < n)
+            ++bits;
+        while (true) {
+            int r = static_cast<int>(take(bits));
+            if (r < n)
+                return r;
+        }
+    }
+
+    // Uniform in [0, 1) with 53 bits of precision.
+    double unit() {
+        return static_cast<double>(take(53)) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    uint64_t take(int bits) {
+        if (bits == 0)
+            return 0;
+        if (m_bits < bits) {
+            if (m_word == block_words) {
+                fill_words(m_engine, m_block.data(), block_words);
+                m_word = 0;
+            }
+            m_current = m_block[m_word++];
+            m_bits = 64;
+        }
+        uint64_t r = bits == 64 ? m_current : m_current & ((uint64_t(1) << bits) - 1);
+        m_current = bits == 64 ? 0 : m_current >> bits;
+        m_bits -= bits;
+        return r;
+    }
+
+    Engine m_engine;
+    std::array<uint64_t, block_words> m_block;
+    size_t m_word;
+    int m_bits;
+    uint64_t m_current;
+};
+
+// Whether draws from Engine are sliced from buffered words rather than made through the
+// standard distributions.
+template<typename Engine>
+struct is_buffered: std::false_type {};
+
+template<typename Engine>
+struct is_buffered<BufferedBits<Engine>>: std::true_type {};
+
+#endif //LINEARWANG_BUFFERED_BITS_H
@@ -0,0 +1,39 @@
+#include "cell_graph.h"
+
+void CellGraph::build(const Board& board){
+    m_width = board.width();
+    ptrdiff_t stride = static_cast<ptrdiff_t>(m_width);
+    m_offsets = {{stride, -1, -stride, 1}};
+    // Tiled and outside cells are never looked up, so their masks are left as they are.
+    m_masks.resize(board.width() * board.height());
+
+    size_t words = board.words_per_row();
+    size_t height = board.height();
+    for (size_t j = 0; j < height; ++j){
+        for (size_t k = 0; k < words; ++k){
+            uint64_t cells = board.untiled_word(j, k);
+            if (cells == 0)
+                continue;
+
+            // Neighbors across each side, aligned on the cells of this word.
+            uint64_t previous = k > 0 ? board.untiled_word(j, k - 1) : 0;
+            uint64_t next = k + 1 < words ? board.untiled_word(j, k + 1) : 0;
+            std::array<uint64_t, 4> across {{
+                    j + 1 < height ? board.untiled_word(j + 1, k) : 0,
+                    (cells << 1) | (previous >> 63),
+                    j > 0 ? board.untiled_word(j - 1, k) : 0,
+                    (cells >> 1) | (next << 63)
+            }};
+
+            size_t row = m_width * j + k * 64;
+            while (cells != 0){
+                int b = __builtin_ctzll(cells);
+                uint8_t mask = 0;
+                for (int side = 0; side < 4; ++side)
+                    mask |= static_cast<uint8_t>(((across[side] >> b) & 1) << side);
+                m_masks[row + static_cast<size_t>(b)] = mask;
+                cells &= cells - 1;
+            }
+        }
+    }
+}
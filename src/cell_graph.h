@@ -0,0 +1,49 @@
+#ifndef LINEARWANG_CELL_GRAPH_H
+#define LINEARWANG_CELL_GRAPH_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "board.h"
+
+// Graph of the untiled cells of a board, built once before its components are solved: one
+// byte per cell holding the 4-bit mask of the sides across which an untiled cell lies.
+// Cells are identified by Board::to_index, so neighbor ids are implicit offsets of the id.
+// The masks stay valid while components are solved one after another, since no two
+// components are adjacent, and solving a component only reads the masks of its own cells.
+class CellGraph {
+public:
+    CellGraph(): m_width(0), m_offsets() {}
+    explicit CellGraph(const Board& board): CellGraph() {
+        build(board);
+    }
+
+    // Computes the masks a 64-bit word of cells at a time. The storage is reused when the
+    // board is not larger than the previous one.
+    void build(const Board& board);
+
+    size_t id(coord_type c) const {
+        return m_width * static_cast<size_t>(c.second) + static_cast<size_t>(c.first);
+    }
+
+    // Bit s is set when the cell across side s, numbered as in adjacent_edges, is untiled.
+    int mask(size_t id) const {
+        return m_masks[id];
+    }
+
+    bool has_neighbor(size_t id, int side) const {
+        return (m_masks[id] >> side) & 1;
+    }
+
+    size_t across(size_t id, int side) const {
+        return id + static_cast<size_t>(m_offsets[side]);
+    }
+
+private:
+    size_t m_width;
+    std::array<ptrdiff_t, 4> m_offsets;
+    std::vector<uint8_t> m_masks;   // only the masks of untiled cells are meaningful
+};
+
+#endif //LINEARWANG_CELL_GRAPH_H
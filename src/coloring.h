@@ -4,29 +4,110 @@
 #include "board.h"
 #include <map>
 #include <array>
+#include <vector>
+#include <cstdint>
 
-typedef std::map<Edge, int, EdgeLess> Coloring;
+// Color reported by lookup_color for edges that have not been colored yet.
+const int UNCOLORED = -1;
 
-inline int get_color(Coloring& c, Edge e) {
-    int result;
-    try{
-        result = c.at(e);
-    } catch (std::out_of_range) {
-        result = -1;
+// Reference backend: one map entry per colored edge.
+class MapColoring {
+public:
+    MapColoring(size_t, size_t) {}
+
+    std::map<Edge, int, EdgeLess> colors;
+};
+
+inline int lookup_color(const MapColoring& c, Edge e) noexcept {
+    auto it = c.colors.find(e);
+    return it == c.colors.end() ? UNCOLORED : it->second;
+}
+
+inline void set_color(MapColoring& c, Edge e, int color) {
+    c.colors[e] = color;
+}
+
+// One value per edge of a width x height board.
+// H edges (i, j) for j in [-1, height) are stored at the Board::to_index of the cell above them,
+// V edges (i, j) for i in [-1, width) use the same layout with a stride of width+1.
+template<typename T>
+class EdgePlanes {
+public:
+    EdgePlanes(): m_width(0) {}
+
+    EdgePlanes(size_t width, size_t height, T value)
+            : m_width(width)
+            , m_h_edges(width * (height + 1), value)
+            , m_v_edges((width + 1) * height, value) {}
+
+    // Makes room for a width x height board, without clearing: the values are left unspecified.
+    void reshape(size_t width, size_t height) {
+        m_width = width;
+        if (m_h_edges.size() < width * (height + 1))
+            m_h_edges.resize(width * (height + 1));
+        if (m_v_edges.size() < (width + 1) * height)
+            m_v_edges.resize((width + 1) * height);
+    }
+
+    const T& operator[](Edge e) const noexcept {
+        return e.o == Orientation::H ? m_h_edges[h_index(e)] : m_v_edges[v_index(e)];
     }
-    return result;
+
+    T& operator[](Edge e) noexcept {
+        return e.o == Orientation::H ? m_h_edges[h_index(e)] : m_v_edges[v_index(e)];
+    }
+
+private:
+    size_t h_index(Edge e) const {
+        return m_width * static_cast<size_t>(e.j + 1) + static_cast<size_t>(e.i);
+    }
+
+    size_t v_index(Edge e) const {
+        return (m_width + 1) * static_cast<size_t>(e.j) + static_cast<size_t>(e.i + 1);
+    }
+
+    size_t m_width;
+    std::vector<T> m_h_edges;
+    std::vector<T> m_v_edges;
+};
+
+// Dense backend: one byte per edge, UNCOLORED when unset.
+class DenseColoring {
+public:
+    DenseColoring(size_t width, size_t height): m_edges(width, height, UNCOLORED) {}
+
+    int get(Edge e) const noexcept {
+        return m_edges[e];
+    }
+
+    void set(Edge e, int color) {
+        m_edges[e] = static_cast<int8_t>(color);
+    }
+
+private:
+    EdgePlanes<int8_t> m_edges;
+};
+
+inline int lookup_color(const DenseColoring& c, Edge e) noexcept {
+    return c.get(e);
 }
 
-inline void set_color(Coloring& c, Edge e, int color) {
-    c[e] = color;
+inline void set_color(DenseColoring& c, Edge e, int color) {
+    c.set(e, color);
 }
 
-inline std::array<int, 4> get_tile(Coloring& c, coord_type current){
+#ifdef LINEARWANG_MAP_COLORING
+typedef MapColoring Coloring;
+#else
+typedef DenseColoring Coloring;
+#endif
+
+inline std::array<int, 4> get_tile(const Coloring& c, coord_type current){
     std::array<int, 4> t {{
-            get_color(c, top(current)),
-            get_color(c, left(current)),
-            get_color(c, bottom(current)),
-            get_color(c, right(current))
+            lookup_color(c, top(current)),
+            lookup_color(c, left(current)),
+            lookup_color(c, bottom(current)),
+            lookup_color(c, right(current))
     }};
     return t;
 }
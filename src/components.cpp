@@ -0,0 +1,185 @@
+#include <algorithm>
+#include "components.h"
+
+namespace {
+
+const uint32_t no_label = UINT32_MAX;
+
+// Maximal horizontal run of untiled cells [begin, end) of the current or the previous row.
+struct Run {
+    int begin;
+    int end;
+    int block;          // column of a 2x2 block made of this run and the row below, -1 if none
+    uint32_t label;
+};
+
+// Union-find node, created for each run that touches no run of the row below. Roots hold
+// the totals of their component, and are created before the other labels of the component.
+struct Label {
+    uint32_t parent;
+    coord_type seed;
+    coord_type low;
+    coord_type high;
+    coord_type block;
+    size_t cell_count;
+    size_t edge_count;
+};
+
+void append_row_runs(const Board& board, int j, std::vector<Run>& runs){
+    int start = -1;
+    for (size_t k = 0; k < board.words_per_row(); ++k){
+        uint64_t bits = board.untiled_word(static_cast<size_t>(j), k);
+        int base = static_cast<int>(k * 64);
+        int pos = 0;
+        while (pos < 64){
+            // Look for the next 1 bit when outside a run and for the next 0 bit inside one.
+            uint64_t rest = (start < 0 ? bits : ~bits) >> pos;
+            if (rest == 0)
+                break;
+            pos += __builtin_ctzll(rest);
+            if (start < 0){
+                start = base + pos;
+            } else {
+                runs.push_back(Run{start, base + pos, -1, no_label});
+                start = -1;
+            }
+        }
+    }
+    if (start >= 0)
+        runs.push_back(Run{start, static_cast<int>(board.width()), -1, no_label});
+}
+
+// Bit i is set when cells i and i+1 of both rows j-1 and j are untiled, for the 64 columns of word k.
+uint64_t block_word(const Board& board, int j, size_t k){
+    size_t lower = static_cast<size_t>(j - 1);
+    size_t upper = static_cast<size_t>(j);
+    uint64_t both = board.untiled_word(lower, k) & board.untiled_word(upper, k);
+    uint64_t next = k + 1 < board.words_per_row() ? board.untiled_word(lower, k + 1) & board.untiled_word(upper, k + 1) : 0;
+    return both & ((both >> 1) | (next << 63));
+}
+
+// Looks for a 2x2 block in each run of row j. Only the words under a run are scanned, and
+// the scan stops at the first block.
+void find_row_blocks(const Board& board, int j, std::vector<Run>& runs){
+    for (Run& run: runs){
+        int i = run.begin;
+        while (i < run.end - 1){
+            size_t k = static_cast<size_t>(i) / 64;
+            uint64_t bits = block_word(board, j, k) >> (i % 64);
+            if (bits != 0){
+                int found = i + __builtin_ctzll(bits);
+                if (found < run.end - 1)
+                    run.block = found;
+                break;
+            }
+            i = static_cast<int>(k + 1) * 64;
+        }
+    }
+}
+
+uint32_t find_root(std::vector<Label>& labels, uint32_t r){
+    while (labels[r].parent != r){
+        labels[r].parent = labels[labels[r].parent].parent;
+        r = labels[r].parent;
+    }
+    return r;
+}
+
+bool before(coord_type a, coord_type b){
+    return a.second < b.second || (a.second == b.second && a.first < b.first);
+}
+
+// Merges the later root into the earlier one, which is first in row-major order.
+void unite(std::vector<Label>& labels, uint32_t a, uint32_t b){
+    a = find_root(labels, a);
+    b = find_root(labels, b);
+    if (a == b)
+        return;
+    if (b < a)
+        std::swap(a, b);
+    Label& to = labels[a];
+    const Label& from = labels[b];
+    to.low.first = std::min(to.low.first, from.low.first);
+    to.high.first = std::max(to.high.first, from.high.first);
+    to.high.second = std::max(to.high.second, from.high.second);
+    if (from.block.first >= 0 && (to.block.first < 0 || before(from.block, to.block)))
+        to.block = from.block;
+    to.cell_count += from.cell_count;
+    to.edge_count += from.edge_count;
+    labels[b].parent = a;
+}
+
+}
+
+std::vector<Component> label_components(const Board& board){
+    // Only the runs of two rows are kept; components are summed up in their root label.
+    std::vector<Run> previous;
+    std::vector<Run> current;
+    std::vector<Label> labels;
+    std::vector<size_t> vertical_edges;     // interior edges joining each current run to the row below
+
+    for (int j = 0; j < static_cast<int>(board.height()); ++j){
+        current.clear();
+        append_row_runs(board, j, current);
+        if (j > 0)
+            find_row_blocks(board, j, current);
+
+        // Runs of both rows are sorted, so overlapping pairs are found by a merge.
+        vertical_edges.assign(current.size(), 0);
+        size_t a = 0;
+        size_t b = 0;
+        while (a < previous.size() && b < current.size()){
+            int overlap = std::min(previous[a].end, current[b].end) - std::max(previous[a].begin, current[b].begin);
+            if (overlap > 0){
+                vertical_edges[b] += static_cast<size_t>(overlap);
+                if (current[b].label == no_label)
+                    current[b].label = previous[a].label;
+                else
+                    unite(labels, current[b].label, previous[a].label);
+            }
+            if (previous[a].end < current[b].end)
+                ++a;
+            else
+                ++b;
+        }
+
+        for (size_t r = 0; r < current.size(); ++r){
+            Run& run = current[r];
+            if (run.label == no_label){
+                run.label = static_cast<uint32_t>(labels.size());
+                coord_type seed = std::make_pair(run.begin, j);
+                labels.push_back(Label{run.label, seed, seed, seed, std::make_pair(-1, -1), 0, 0});
+            }
+            Label& root = labels[find_root(labels, run.label)];
+            size_t length = static_cast<size_t>(run.end - run.begin);
+            root.low.first = std::min(root.low.first, run.begin);
+            root.high.first = std::max(root.high.first, run.end - 1);
+            root.high.second = j;
+            if (root.block.first < 0 && run.block >= 0)
+                root.block = std::make_pair(run.block, j - 1);
+            root.cell_count += length;
+            root.edge_count += length - 1 + vertical_edges[r];
+        }
+        std::swap(previous, current);
+    }
+
+    // Roots are created in row-major order of their seed.
+    std::vector<Component> components;
+    for (uint32_t r = 0; r < labels.size(); ++r){
+        const Label& label = labels[r];
+        if (label.parent != r)
+            continue;
+        Component c;
+        c.id = components.size();
+        c.seed = label.seed;
+        c.cell_count = label.cell_count;
+        c.low = label.low;
+        c.high = label.high;
+        c.cyclic = label.edge_count >= label.cell_count;
+        c.has_block = label.block.first >= 0;
+        c.block = label.block;
+        c.origin = std::make_pair(0, 0);
+        components.push_back(c);
+    }
+    return components;
+}
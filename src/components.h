@@ -0,0 +1,24 @@
+#ifndef LINEARWANG_COMPONENTS_H
+#define LINEARWANG_COMPONENTS_H
+
+#include <vector>
+#include "board.h"
+
+struct Component {
+    size_t id;
+    coord_type seed;        // first cell of the component in row-major order
+    size_t cell_count;
+    coord_type low;         // bounding box, inclusive
+    coord_type high;
+    bool cyclic;            // the component graph has more interior edges than a tree
+    bool has_block;         // the component contains a 2x2 block of cells, hence a 4-cycle
+    coord_type block;       // lower left cell of the first such block
+    coord_type origin;      // where the board holding these coordinates lies in the input mask
+};
+
+// Labels the connected components of the untiled cells of the board in a single scanline
+// pass, which also looks for 2x2 blocks with a word-parallel scan of adjacent rows.
+// Components are returned in row-major order of their seed cells.
+std::vector<Component> label_components(const Board& board);
+
+#endif //LINEARWANG_COMPONENTS_H
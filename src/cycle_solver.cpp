@@ -1,8 +1,11 @@
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include "cycle_solver.h"
 
-std::vector<std::shared_ptr<CellType>> analysis(Coloring& coloring, const std::vector<coord_type>& cycle) {
-    std::vector<std::shared_ptr<CellType>> types;
+void analysis(Coloring& coloring, const std::vector<coord_type>& cycle, CycleCells& types) {
+    types.clear();
+    types.reserve(cycle.size());
 
     coord_type previous = cycle.back();
 
@@ -22,36 +25,36 @@ std::vector<std::shared_ptr<CellType>> analysis(Coloring& coloring, const std::v
                 output = right(c);
             else
                 output = left(c);
-            types.push_back(std::shared_ptr<CellType>(new Straight(t[0], t[2], c, input, output)));
+            types.push_back(CycleCells::Straight, t[0], t[2], input, output);
         } else if (t[1] != -1 && t[3] != -1) {
             if (input == top(c))
                 output = bottom(c);
             else
                 output = top(c);
-            types.push_back(std::shared_ptr<CellType>(new Straight(t[1], t[3], c, input, output)));
+            types.push_back(CycleCells::Straight, t[1], t[3], input, output);
         } else if (t[0] != -1 && t[1] != -1) {
             if (input == bottom(c)){
-                types.push_back(std::shared_ptr<CellType>(new Corner(t[0], t[1], c, input, right(c))));
+                types.push_back(CycleCells::Corner, t[0], t[1], input, right(c));
             } else {
-                types.push_back(std::shared_ptr<CellType>(new Corner(t[1], t[0], c, input, bottom(c))));
+                types.push_back(CycleCells::Corner, t[1], t[0], input, bottom(c));
             }
         } else if (t[1] != -1 && t[2] != -1) {
             if (input == top(c)){
-                types.push_back(std::shared_ptr<CellType>(new Corner(t[2], t[1], c, input, right(c))));
+                types.push_back(CycleCells::Corner, t[2], t[1], input, right(c));
             } else {
-                types.push_back(std::shared_ptr<CellType>(new Corner(t[1], t[2], c, input, top(c))));
+                types.push_back(CycleCells::Corner, t[1], t[2], input, top(c));
             }
         } else if (t[2] != -1 && t[3] != -1) {
             if (input == top(c)) {
-                types.push_back(std::shared_ptr<CellType>(new Corner(t[2], t[3], c, input, left(c))));
+                types.push_back(CycleCells::Corner, t[2], t[3], input, left(c));
             } else {
-                types.push_back(std::shared_ptr<CellType>(new Corner(t[3], t[2], c, input, top(c))));
+                types.push_back(CycleCells::Corner, t[3], t[2], input, top(c));
             }
         } else if (t[3] != -1 && t[0] != -1) {
             if (input == bottom(c)) {
-                types.push_back(std::shared_ptr<CellType>(new Corner(t[0], t[3], c, input, left(c))));
+                types.push_back(CycleCells::Corner, t[0], t[3], input, left(c));
             } else {
-                types.push_back(std::shared_ptr<CellType>(new Corner(t[3], t[0], c, input, bottom(c))));
+                types.push_back(CycleCells::Corner, t[3], t[0], input, bottom(c));
             }
         } else {
             std::cerr << "Error in the cycle analysis\n";
@@ -59,117 +62,178 @@ std::vector<std::shared_ptr<CellType>> analysis(Coloring& coloring, const std::v
         }
         previous = c;
     }
+}
+
+namespace {
+
+// Storage of complete_coloring_cycle, kept from one cycle to the next by each thread.
+struct CycleWorkspace {
+    CycleCells types;
+    std::vector<size_t> primitive;  // positions in types of the cells that do not just pass the color through
+};
 
-    return types;
 }
 
-void complete_coloring_cycle(ColorGeneration g, Board& board, Coloring& coloring, const std::vector<coord_type>& cycle){
-    auto types = analysis(coloring, cycle);
+template<typename Generation>
+int propagate_chain(Generation& g, ThreadPool* pool, CycleCells& types, const std::vector<size_t>& primitive, size_t begin, int in){
+    if (pool == nullptr || primitive.size() < pool->thresholds().cycle_length) {
+        for (size_t index = begin; index < primitive.size(); ++index)
+            in = types.propagate(g, primitive[index], in);
+        return in;
+    }
 
-    if (types.size() != cycle.size()){
-        std::cerr<<"Error in analysing the cycle: size mismatch.\n";
-        exit(1);
+    // Every cell may need one draw among the colors but one; drawing them all up front turns
+    // each cell into a fixed map of its input color, and the chain into their composition.
+    const int colors = Generation::bound();
+    typedef std::array<int8_t, Generation::bound()> ColorMap;
+    size_t length = primitive.size() - begin;
+    std::vector<int8_t> draws(length);
+    for (auto& r: draws)
+        r = static_cast<int8_t>(g.pick_below(colors - 1));
+
+    const size_t chain_block = pool->thresholds().chain_block;
+    size_t blocks = (length + chain_block - 1) / chain_block;
+    std::vector<ColorMap> maps(blocks);
+    {
+        TaskGroup tasks(*pool);
+        for (size_t block = 0; block < blocks; ++block) {
+            tasks.run([&, block]() {
+                ColorMap& map = maps[block];
+                for (int c = 0; c < colors; ++c)
+                    map[c] = static_cast<int8_t>(c);
+                size_t end = std::min(length, (block + 1) * chain_block);
+                for (size_t index = block * chain_block; index < end; ++index) {
+                    for (int c = 0; c < colors; ++c)
+                        map[c] = static_cast<int8_t>(types.step(primitive[begin + index], map[c], draws[index]));
+                }
+            });
+        }
     }
 
-    std::vector<std::shared_ptr<CellType>> primitive;
-    std::copy_if(
-            types.begin(),
-            types.end(),
-            std::back_inserter(primitive),
-            [](std::shared_ptr<CellType> c) { return !c->is_pass(); }
-    );
+    // Color entering each block, then every block colors its cells from it.
+    std::vector<int8_t> block_in(blocks + 1);
+    block_in[0] = static_cast<int8_t>(in);
+    for (size_t block = 0; block < blocks; ++block)
+        block_in[block + 1] = maps[block][block_in[block]];
+
+    TaskGroup tasks(*pool);
+    for (size_t block = 0; block < blocks; ++block) {
+        tasks.run([&, block]() {
+            int color = block_in[block];
+            size_t end = std::min(length, (block + 1) * chain_block);
+            for (size_t index = block * chain_block; index < end; ++index) {
+                size_t k = primitive[begin + index];
+                types.in_color[k] = static_cast<int8_t>(color);
+                color = types.step(k, color, draws[index]);
+                types.out_color[k] = static_cast<int8_t>(color);
+            }
+        });
+    }
+    tasks.wait();
+    return block_in[blocks];
+}
 
-    auto sit = std::find_if(primitive.begin(), primitive.end(), [](std::shared_ptr<CellType> c) { return c->is_straight();});
+template<typename Generation>
+void complete_coloring_cycle(Generation& g, Board& board, Coloring& coloring, const std::vector<coord_type>& cycle, ThreadPool* pool){
+    // Kept per thread: the chain tasks of a cycle never start another cycle.
+    static thread_local CycleWorkspace workspace;
+    CycleCells& types = workspace.types;
+    std::vector<size_t>& primitive = workspace.primitive;
+
+    analysis(coloring, cycle, types);
+    primitive.clear();
+    for (size_t k = 0; k < types.size(); ++k)
+        if (!types.is_pass(k))
+            primitive.push_back(k);
+
+    auto sit = std::find_if(primitive.begin(), primitive.end(), [&types](size_t k) { return types.is_straight(k); });
 
     if (sit != primitive.end()){
         std::rotate(primitive.begin(), sit, primitive.end());
-        if (primitive[1]->is_straight()) {
-            auto first = dynamic_cast<Straight*>(primitive[0].get());
-            auto second = dynamic_cast<Straight*>(primitive[1].get());
+        size_t first = primitive[0];
+        size_t second = primitive[1];
+        if (types.is_straight(second)) {
             int c = g.pick_color();
-            second->out_color = c;
+            types.out_color[second] = static_cast<int8_t>(c);
             int output = c;
 
-            for(size_t index = 2; index < primitive.size(); ++index){
-                output = primitive[index]->propagate(g, output);
-            }
+            output = propagate_chain(g, pool, types, primitive, 2, output);
             int diff = g.pick_different_color(output, c);
-            first->in_color = output;
-            first->out_color = diff;
-            second->in_color = diff;
+            types.in_color[first] = static_cast<int8_t>(output);
+            types.out_color[first] = static_cast<int8_t>(diff);
+            types.in_color[second] = static_cast<int8_t>(diff);
 
         } else {
-            auto first = dynamic_cast<Straight*>(primitive[0].get());
-            auto second = dynamic_cast<Corner*>(primitive[1].get());
-            int c = second->b;
-            second->out_color = c;
+            int c = types.b[second];
+            types.out_color[second] = static_cast<int8_t>(c);
             int output = c;
 
-            for(size_t index = 2; index < primitive.size(); ++index){
-                output = primitive[index]->propagate(g, output);
-            }
-            int diff = g.pick_different_color(output, second->a);
-            first->in_color = output;
-            first->out_color = diff;
-            second->in_color = diff;
+            output = propagate_chain(g, pool, types, primitive, 2, output);
+            int diff = g.pick_different_color(output, types.a[second]);
+            types.in_color[first] = static_cast<int8_t>(output);
+            types.out_color[first] = static_cast<int8_t>(diff);
+            types.in_color[second] = static_cast<int8_t>(diff);
         }
     } else {
+        // Only corners: look for two consecutive ones that do not chain, b of the first
+        // differing from a of the second.
         auto current = primitive.end()-1;
         auto next = primitive.begin();
         for (; next != primitive.end(); ++next){
-            auto f = dynamic_cast<Corner*>((*current).get());
-            auto s = dynamic_cast<Corner*>((*next).get());
-            if (f->b != s->a) break;
+            if (types.b[*current] != types.a[*next]) break;
             current = next;
         }
 
         if (next != primitive.end()){
             std::rotate(primitive.begin(), current, primitive.end());
-            auto first = dynamic_cast<Corner*>(primitive[0].get());
-            auto second = dynamic_cast<Corner*>(primitive[1].get());
-            int c = second->b;
-            second->out_color = c;
+            size_t first = primitive[0];
+            size_t second = primitive[1];
+            int c = types.b[second];
+            types.out_color[second] = static_cast<int8_t>(c);
             int output = c;
 
-            for(size_t index = 2; index < primitive.size(); ++index){
-                output = primitive[index]->propagate(g, output);
-            }
+            output = propagate_chain(g, pool, types, primitive, 2, output);
             int diff;
-            if (output == first->a)
-                diff = g.pick_different_color(first->b, second->a);
+            if (output == types.a[first])
+                diff = g.pick_different_color(types.b[first], types.a[second]);
             else
-                diff = first->b;
+                diff = types.b[first];
 
-            first->in_color = output;
-            first->out_color = diff;
-            second->in_color = diff;
+            types.in_color[first] = static_cast<int8_t>(output);
+            types.out_color[first] = static_cast<int8_t>(diff);
+            types.in_color[second] = static_cast<int8_t>(diff);
         } else {
             for(size_t index = 0 ; index < primitive.size(); index += 2){
-                auto first = dynamic_cast<Corner*>(primitive[index].get());
-                auto second = dynamic_cast<Corner*>(primitive[index+1].get());
-                first->in_color = first->a;
-                first->out_color = g.pick_different_color(first->b);
-                second->in_color = first->out_color;
-                second->out_color = second->b;
+                size_t first = primitive[index];
+                size_t second = primitive[index+1];
+                types.in_color[first] = types.a[first];
+                types.out_color[first] = static_cast<int8_t>(g.pick_different_color(types.b[first]));
+                types.in_color[second] = types.out_color[first];
+                types.out_color[second] = types.b[second];
             }
         }
     }
 
-    auto current = types.back();
-    for (auto c: types){
-        if (c->is_pass()){
-            auto first = dynamic_cast<Straight*>(c.get());
-            first->in_color = current->out_color;
-            first->out_color = first->in_color;
+    size_t current = types.size() - 1;
+    for (size_t k = 0; k < types.size(); ++k){
+        if (types.is_pass(k)){
+            types.in_color[k] = types.out_color[current];
+            types.out_color[k] = types.in_color[k];
         }
-        current = c;
+        current = k;
     }
 
-    for(auto c: types){
-        set_color(coloring, c->input, c->in_color);
-        set_color(coloring, c->output, c->out_color);
-        board.set_to_tiled(c->pos);
+    for (size_t k = 0; k < types.size(); ++k){
+        set_color(coloring, types.input[k], types.in_color[k]);
+        set_color(coloring, types.output[k], types.out_color[k]);
+        board.set_to_tiled(cycle[k]);
     }
+}
 
-
-}
\ No newline at end of file
+#define INSTANTIATE_ENGINE(Colors, Engine) \
+    template int propagate_chain(BasicColorGeneration<Colors, Engine>& g, ThreadPool* pool, CycleCells& types, const std::vector<size_t>& primitive, size_t begin, int in); \
+    template void complete_coloring_cycle(BasicColorGeneration<Colors, Engine>& g, Board& board, Coloring& coloring, const std::vector<coord_type>& cycle, ThreadPool* pool);
+#define INSTANTIATE(Colors) LINEARWANG_FOR_EACH_ENGINE(INSTANTIATE_ENGINE, Colors)
+LINEARWANG_FOR_EACH_COLOR_COUNT(INSTANTIATE)
+#undef INSTANTIATE
+#undef INSTANTIATE_ENGINE
@@ -1,78 +1,120 @@
 #ifndef LINEARWANG_CYCLE_SOLVER_H
 #define LINEARWANG_CYCLE_SOLVER_H
 
+#include <cstdint>
+#include <vector>
 #include "board.h"
 #include "coloring.h"
 #include "wang.h"
-
-class CellType {
-public:
-    CellType(coord_type pos, Edge input, Edge output): pos(pos), input(input), output(output), in_color(-1), out_color(-1) {}
-
-    virtual ~CellType() = default;
-    virtual bool is_pass() = 0;
-    virtual bool is_straight() = 0;
-    virtual int propagate(ColorGeneration g, int in_color) = 0;
-
-    coord_type pos;
-    Edge input;
-    Edge output;
-    int in_color;
-    int out_color;
-};
-
-class Straight: public CellType {
-public:
-    Straight(int a, int b, coord_type pos, Edge input, Edge output): CellType(pos, input, output), a(a), b(b) {}
-
-    int propagate(ColorGeneration g, int inc) final {
-        in_color = inc;
-        if (a == b)
-            out_color = g.pick_different_color(inc);
-        else
-            out_color = inc;
-        return out_color;
+#include "thread_pool.h"
+
+// Cells of a cycle in order, as parallel arrays. Each cell has two colored sides, a and b,
+// and is crossed by the cycle through its input and output edges. In a straight cell the
+// colored sides face each other; in a corner a is opposite the input edge and b opposite
+// the output edge.
+struct CycleCells {
+    enum Kind : uint8_t { Straight, Corner };
+
+    std::vector<uint8_t> kind;
+    std::vector<int8_t> a;
+    std::vector<int8_t> b;
+    std::vector<int8_t> in_color;
+    std::vector<int8_t> out_color;
+    std::vector<Edge> input;
+    std::vector<Edge> output;
+
+    size_t size() const {
+        return kind.size();
     }
 
-    bool is_pass() final {
-        return a != b;
+    void clear() {
+        kind.clear();
+        a.clear();
+        b.clear();
+        in_color.clear();
+        out_color.clear();
+        input.clear();
+        output.clear();
     }
 
-    bool is_straight() final {
-        return true;
+    void reserve(size_t n) {
+        kind.reserve(n);
+        a.reserve(n);
+        b.reserve(n);
+        in_color.reserve(n);
+        out_color.reserve(n);
+        input.reserve(n);
+        output.reserve(n);
     }
 
-    int a;
-    int b;
-
-};
-
-class Corner: public CellType {
-public:
-    Corner(int a, int b, coord_type pos, Edge input, Edge output): CellType(pos, input, output), a(a), b(b) {}
+    void push_back(Kind k, int first, int second, Edge in, Edge out) {
+        kind.push_back(k);
+        a.push_back(static_cast<int8_t>(first));
+        b.push_back(static_cast<int8_t>(second));
+        in_color.push_back(-1);
+        out_color.push_back(-1);
+        input.push_back(in);
+        output.push_back(out);
+    }
 
-    int propagate(ColorGeneration g, int inc) final {
-        in_color = inc;
-        if (a == in_color)
-            out_color = g.pick_different_color(b);
-        else
-            out_color = b;
-        return out_color;
+    // A straight cell between two different colors lets the color through unchanged.
+    bool is_pass(size_t k) const {
+        return kind[k] == Straight && a[k] != b[k];
     }
 
-    bool is_pass() final {
-        return false;
+    bool is_straight(size_t k) const {
+        return kind[k] == Straight;
     }
 
-    bool is_straight() final {
-        return false;
+    // Output color of cell k for the input color in, when the random choice the cell may need
+    // has been drawn beforehand as r, an index among the colors but one.
+    int step(size_t k, int in, int r) const {
+        int excluded;
+        switch (kind[k]) {
+            case Straight:
+                if (a[k] != b[k])
+                    return in;
+                excluded = in;
+                break;
+            default:
+                if (a[k] != in)
+                    return b[k];
+                excluded = b[k];
+                break;
+        }
+        return r < excluded ? r : r + 1;
     }
 
-    int a;
-    int b;
+    // Colors the output edge of cell k given the color of its input edge.
+    template<typename Generation>
+    int propagate(Generation& g, size_t k, int in) {
+        int out;
+        switch (kind[k]) {
+            case Straight:
+                out = a[k] == b[k] ? g.pick_different_color(in) : in;
+                break;
+            default:
+                out = a[k] == in ? g.pick_different_color(b[k]) : b[k];
+                break;
+        }
+        in_color[k] = static_cast<int8_t>(in);
+        out_color[k] = static_cast<int8_t>(out);
+        return out;
+    }
 };
 
-std::vector<std::shared_ptr<CellType>> analysis(Coloring& coloring, const std::vector<coord_type>& cycle);
-void complete_coloring_cycle(ColorGeneration g, Board& board, Coloring& coloring, const std::vector<coord_type>& cycle);
+// Fills types with the cells of the cycle, reusing its storage.
+void analysis(Coloring& coloring, const std::vector<coord_type>& cycle, CycleCells& types);
+
+// Propagates the color in through the cells primitive[begin..] of the cycle, writing their
+// input and output colors, and returns the color leaving the last one. Given a pool, chains
+// of at least its cycle_length threshold are propagated with a parallel scan. Their random
+// choices are then all drawn before the propagation, in cycle order, so the colors differ
+// from the serial solver's but not with the number of threads.
+template<typename Generation>
+int propagate_chain(Generation& g, ThreadPool* pool, CycleCells& types, const std::vector<size_t>& primitive, size_t begin, int in);
+
+template<typename Generation>
+void complete_coloring_cycle(Generation& g, Board& board, Coloring& coloring, const std::vector<coord_type>& cycle, ThreadPool* pool = nullptr);
 
 #endif //LINEARWANG_CYCLE_SOLVER_H
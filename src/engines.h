@@ -0,0 +1,152 @@
+#ifndef LINEARWANG_ENGINES_H
+#define LINEARWANG_ENGINES_H
+
+#include <cstdint>
+
+// Small 64-bit engines meeting the UniformRandomBitGenerator requirements, as faster
+// alternatives to std::mt19937 for the serial solver. They are meant to be read through
+// BufferedBits, which takes whole 64-bit words from them.
+
+// SplitMix64 (Steele, Lea and Flood), as published by Vigna. Also used to expand a seed
+// into the larger states of the other engines.
+class SplitMix64 {
+public:
+    typedef uint64_t result_type;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+
+    explicit SplitMix64(uint64_t seed): m_state(seed) {}
+
+    result_type operator()() {
+        uint64_t z = (m_state += 0x9E3779B97F4A7C15);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+        return z ^ (z >> 31);
+    }
+
+private:
+    uint64_t m_state;
+};
+
+// xoshiro256** 1.0 (Blackman and Vigna), seeded with four SplitMix64 outputs.
+class Xoshiro256 {
+public:
+    typedef uint64_t result_type;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+
+    explicit Xoshiro256(uint64_t seed) {
+        SplitMix64 expand(seed);
+        for (auto& word: m_state)
+            word = expand();
+    }
+
+    result_type operator()() {
+        uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+        uint64_t t = m_state[1] << 17;
+        m_state[2] ^= m_state[0];
+        m_state[3] ^= m_state[1];
+        m_state[1] ^= m_state[2];
+        m_state[0] ^= m_state[3];
+        m_state[2] ^= t;
+        m_state[3] = rotl(m_state[3], 45);
+        return result;
+    }
+
+    // Advances the state by 2^128 draws, as jump() of the reference implementation.
+    void jump() {
+        static const uint64_t polynomial[4] = {
+                0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+        uint64_t jumped[4] = {0, 0, 0, 0};
+        for (uint64_t word: polynomial) {
+            for (int bit = 0; bit < 64; ++bit) {
+                if (word & (uint64_t(1) << bit)) {
+                    for (int k = 0; k < 4; ++k)
+                        jumped[k] ^= m_state[k];
+                }
+                (*this)();
+            }
+        }
+        for (int k = 0; k < 4; ++k)
+            m_state[k] = jumped[k];
+    }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t m_state[4];
+};
+
+// PCG64, i.e. PCG XSL RR 128/64 (O'Neill) with the default multiplier. The seed and the
+// stream selector are both drawn from SplitMix64.
+class Pcg64 {
+public:
+    typedef uint64_t result_type;
+    typedef unsigned __int128 uint128;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+
+    explicit Pcg64(uint64_t seed): m_state(0), m_increment(0) {
+        SplitMix64 expand(seed);
+        uint128 initial = (uint128(expand()) << 64) | expand();
+        uint128 stream = (uint128(expand()) << 64) | expand();
+        seed_state(initial, stream);
+    }
+
+    // Seeds like pcg64_srandom_r of the reference implementation.
+    Pcg64(uint128 initial, uint128 stream): m_state(0), m_increment(0) {
+        seed_state(initial, stream);
+    }
+
+    result_type operator()() {
+        step();
+        uint64_t x = static_cast<uint64_t>(m_state >> 64) ^ static_cast<uint64_t>(m_state);
+        int rotation = static_cast<int>(m_state >> 122);
+        return (x >> rotation) | (x << ((-rotation) & 63));
+    }
+
+    // Advances the state by delta draws in O(log delta) steps, as pcg_advance_lcg_128 of the
+    // reference implementation.
+    void advance(uint128 delta) {
+        uint128 multiplier = step_multiplier();
+        uint128 increment = m_increment;
+        uint128 total_multiplier = 1;
+        uint128 total_increment = 0;
+        while (delta > 0) {
+            if (delta & 1) {
+                total_multiplier *= multiplier;
+                total_increment = total_increment * multiplier + increment;
+            }
+            increment = (multiplier + 1) * increment;
+            multiplier *= multiplier;
+            delta >>= 1;
+        }
+        m_state = total_multiplier * m_state + total_increment;
+    }
+
+private:
+    void seed_state(uint128 initial, uint128 stream) {
+        m_increment = (stream << 1) | 1;
+        step();
+        m_state += initial;
+        step();
+    }
+
+    static uint128 step_multiplier() {
+        return (uint128(2549297995355413924ULL) << 64) | 4865540595714422341ULL;
+    }
+
+    void step() {
+        m_state = m_state * step_multiplier() + m_increment;
+    }
+
+    uint128 m_state;
+    uint128 m_increment;
+};
+
+#endif //LINEARWANG_ENGINES_H
@@ -1,117 +1,309 @@
 #include <vector>
+#include <algorithm>
 #include <map>
 #include <iostream>
 #include "general.h"
 #include "wang.h"
 #include "cycle_solver.h"
 #include "tree_solver.h"
+#include "thread_pool.h"
 
-std::vector<coord_type> find_cycle_by_dfs(Board& board, coord_type first_cell){
+void find_cycle_by_dfs(Board& board, const CellGraph& graph, coord_type first_cell, std::vector<coord_type>& cycle){
     board.clean_marks();
-    std::vector<coord_type> precedent;
-
+    cycle.clear();
 
+    // DFS frame: the cell and its id, the side it was entered from and the next side to explore.
+    // Only the edge back to the parent has to be skipped: the first other edge reaching a
+    // marked cell closes a cycle with a cell of the stack.
+    struct Frame {
+        coord_type cell;
+        size_t id;
+        int parent_side;
+        int next_side;
+    };
+    // Kept between searches: a search runs no task, so it cannot start another one on this thread.
+    static thread_local std::vector<Frame> stack;
+    stack.clear();
 
     board.mark(first_cell);
-    precedent.push_back(first_cell);
-    std::set<Edge, EdgeLess> visitedEdges;
-
-    while(!precedent.empty()){
-        auto current = precedent.back();
+    stack.push_back(Frame{first_cell, graph.id(first_cell), -1, 0});
 
-        auto adjacents = adjacent_edges(current);
-        auto nextIt = std::find_if(adjacents.begin(), adjacents.end(), [board, &visitedEdges](Edge& e){ return (board.is_interior_edge(e) && visitedEdges.count(e) == 0); });
+    while(!stack.empty()){
+        Frame& current = stack.back();
+        if (current.next_side == 4){
+            stack.pop_back();
+            continue;
+        }
 
-        if (nextIt == adjacents.end()){
-            //All adjacent edges have been visited
-            precedent.pop_back();
-        } else {
-            auto next = *nextIt;
-            visitedEdges.insert(next);
-            auto f = first(next);
-            auto s = second(next);
-            std::pair<int, int> nextCell;
-            if (f == current)
-                nextCell = s;
-            else
-                nextCell = f;
-
-            if (board.is_marked(nextCell)){
-                //We found a cycle
-                auto start = std::find(precedent.begin(), precedent.end(), nextCell);
-                std::vector<coord_type> cycle;
-                std::copy(start, precedent.end(), std::back_inserter(cycle));
-                board.clean_marks();
-                return cycle;
-            } else {
-                board.mark(nextCell);
-                precedent.push_back(nextCell);
-            }
+        int side = current.next_side++;
+        if (side == current.parent_side || !graph.has_neighbor(current.id, side))
+            continue;
 
+        coord_type nextCell = across_side(current.cell, side);
+        if (board.is_marked(nextCell)){
+            //We found a cycle
+            size_t start = stack.size() - 1;
+            while (stack[start].cell != nextCell)
+                --start;
+            for (size_t index = start; index < stack.size(); ++index)
+                cycle.push_back(stack[index].cell);
+            board.clean_marks();
+            return;
         }
+
+        board.mark(nextCell);
+        stack.push_back(Frame{nextCell, graph.across(current.id, side), (side + 2) % 4, 0});
     }
     board.clean_marks();
-    return std::vector<coord_type>();
 }
 
-void complete_coloring (ColorGeneration gen, Board& board, Coloring& coloring){
+void block_cycle(coord_type corner, std::vector<coord_type>& cycle){
+    int i = corner.first;
+    int j = corner.second;
+    cycle.assign({
+            std::make_pair(i, j), std::make_pair(i+1, j), std::make_pair(i+1, j+1), std::make_pair(i, j+1)
+    });
+}
 
-    while(true) {
+namespace {
 
-        coord_type first_cell;
+// Visits the cells hanging off the marked cycle, each subtree in post-order. end_subtree is
+// called after each subtree.
+template<typename Visit, typename EndSubtree>
+void hanging_subtrees(Board& board, const CellGraph& graph, const std::vector<coord_type>& cycle, const Visit& visit, const EndSubtree& end_subtree){
+    // DFS frame: the cell, its id and the next side to look across.
+    struct Frame {
+        coord_type cell;
+        size_t id;
+        int next_side;
+    };
+    // Kept between calls: visit and end_subtree run no task, so no other call can start on this thread.
+    static thread_local std::vector<Frame> stack;
+    for (auto c: cycle) {
+        size_t id = graph.id(c);
+        for (int side = 0; side < 4; ++side) {
+            if (!graph.has_neighbor(id, side))
+                continue;
+            coord_type n = across_side(c, side);
+            if (board.is_marked(n))
+                continue;
+            board.mark(n);
 
-        try {
-            first_cell = board.find_a_cell();
-        } catch (Board::EmptyBoard) {
-            break;
+            stack.push_back(Frame{n, graph.across(id, side), 0});
+            while (!stack.empty()) {
+                Frame& current = stack.back();
+                if (current.next_side == 4) {
+                    visit(current.cell);
+                    stack.pop_back();
+                    continue;
+                }
+                int next_side = current.next_side++;
+                if (!graph.has_neighbor(current.id, next_side))
+                    continue;
+                coord_type next = across_side(current.cell, next_side);
+                if (board.is_marked(next))
+                    continue;
+                board.mark(next);
+                stack.push_back(Frame{next, graph.across(current.id, next_side), 0});
+            }
+            end_subtree();
         }
+    }
+}
 
+// Streams of subtree batches are labelled by their first cell with the top bit set, so they
+// never meet the stream of a component, labelled by its seed cell.
+const uint64_t subtree_stream = uint64_t(1) << 63;
 
-        auto cycle = find_cycle_by_dfs(board, first_cell);
+// Distinct subtrees share no edge and only read their edges to the cycle, which are not
+// colored yet, so batches of them can be completed concurrently. Each batch draws from its
+// own generation, split from gen in batch order, and batches are cut by cell count alone:
+// the colors do not depend on the number of threads.
+template<typename Generation>
+void complete_subtrees_in_parallel(Generation& gen, Board& board, const CellGraph& graph, Coloring& coloring, const std::vector<coord_type>& cycle, ThreadPool& pool){
+    std::vector<coord_type> order;
+    std::vector<size_t> batch_ends;
+    hanging_subtrees(board, graph, cycle,
+                     [&order](coord_type c) { order.push_back(c); },
+                     [&order, &batch_ends, &pool]() {
+                         size_t begin = batch_ends.empty() ? 0 : batch_ends.back();
+                         if (order.size() - begin >= pool.thresholds().subtree_batch)
+                             batch_ends.push_back(order.size());
+                     });
+    if (order.size() > (batch_ends.empty() ? 0 : batch_ends.back()))
+        batch_ends.push_back(order.size());
 
+    std::vector<typename Generation::engine_type> engines;
+    engines.reserve(batch_ends.size());
+    for (size_t batch = 0; batch < batch_ends.size(); ++batch) {
+        coord_type first_cell = order[batch == 0 ? 0 : batch_ends[batch - 1]];
+        engines.push_back(gen.split(subtree_stream | board.to_index(first_cell)));
+    }
 
-        if (!cycle.empty())
-        {
-            for (auto c: cycle) {
-                board.mark(c);
+    TaskGroup tasks(pool);
+    for (size_t batch = 0; batch < batch_ends.size(); ++batch) {
+        tasks.run([&, batch]() {
+            Generation batch_gen(engines[batch]);
+            for (size_t index = batch == 0 ? 0 : batch_ends[batch - 1]; index < batch_ends[batch]; ++index) {
+                auto t = get_tile(coloring, order[index]);
+                batch_gen.complete_tile(t);
+                set_tile(coloring, order[index], t);
             }
+        });
+    }
+    tasks.wait();
 
-            for (auto c: cycle) {
-                auto neighbors = board.neighbors(c);
-                for (auto n: neighbors) {
-                    if (board.is_marked(n))
-                        continue;
-                    board.mark(n);
-
-                    std::vector<coord_type> stack;
-                    stack.push_back(n);
-                    while (!stack.empty()) {
-                        auto current = stack.back();
-                        auto candidates = board.neighbors(current);
-                        std::vector<coord_type> next;
-                        auto nextIt = std::find_if(candidates.begin(), candidates.end(),
-                                                   [board](coord_type c) { return !board.is_marked(c); });
-                        if (nextIt == candidates.end()) {
-                            stack.pop_back();
-                            auto t = get_tile(coloring, current);
-                            gen.complete_tile(t);
-                            set_tile(coloring, current, t);
-                            board.set_to_tiled(current);
-                        } else {
-                            board.mark(*nextIt);
-                            stack.push_back((*nextIt));
-                        }
-                    }
-                }
-            }
+    // The board is a bitmap, shared between neighboring cells: update it from one thread.
+    for (auto c: order)
+        board.set_to_tiled(c);
+}
+
+}
 
-            complete_coloring_cycle(gen, board, coloring, cycle);
+template<typename Generation>
+void complete_component (Generation& gen, Board& board, const CellGraph& graph, Coloring& coloring, const Component& component, ThreadPool* pool){
+    // The cycle of one component is rebuilt in place for the next one solved by the same
+    // thread. A thread waiting for the tasks of a component only runs tasks of that
+    // component, so it never starts another one meanwhile.
+    static thread_local std::vector<coord_type> cycle;
+
+    // Any 2x2 block is a cycle without chords; the general search is left for thin components.
+    cycle.clear();
+    if (component.has_block)
+        block_cycle(component.block, cycle);
+    else if (component.cyclic)
+        find_cycle_by_dfs(board, graph, component.seed, cycle);
+
+    if (!cycle.empty())
+    {
+        for (auto c: cycle) {
+            board.mark(c);
+        }
+
+        if (pool != nullptr && component.cell_count >= pool->thresholds().subtree_cells) {
+            complete_subtrees_in_parallel(gen, board, graph, coloring, cycle, *pool);
         } else {
-            std::cout<<"Using tree solver\n";
-            if (!solve_tree_from_root(gen, board, coloring, first_cell)) {
-                std::cerr << "Tree structure with root in "<< first_cell<<" is unsolvable.\n";
-                exit(1);
+            hanging_subtrees(board, graph, cycle, [&gen, &board, &coloring](coord_type current) {
+                auto t = get_tile(coloring, current);
+                gen.complete_tile(t);
+                set_tile(coloring, current, t);
+                board.set_to_tiled(current);
+            }, []() {});
+        }
+
+        complete_coloring_cycle(gen, board, coloring, cycle, pool);
+    } else {
+        std::cout<<"Using tree solver\n";
+        if (!solve_tree_from_root(gen, board, graph, coloring, component.seed, pool)) {
+            coord_type root = std::make_pair(component.origin.first + component.seed.first,
+                                             component.origin.second + component.seed.second);
+            std::cerr << "Tree structure with root in "<< root<<" is unsolvable.\n";
+            exit(1);
+        }
+    }
+}
+
+template<typename Generation>
+void complete_coloring (Generation& gen, Board& board, Coloring& coloring){
+    std::vector<Component> components = label_components(board);
+    CellGraph graph(board);
+    for (const auto& component: components)
+        complete_component(gen, board, graph, coloring, component);
+}
+
+template<typename Generation>
+void complete_component_locally (Generation& gen, const Board& board, Coloring& coloring, const Component& component, ThreadPool* pool){
+    coord_type low = component.low;
+    auto to_local = [low](coord_type c) { return std::make_pair(c.first - low.first, c.second - low.second); };
+    auto to_local_edge = [low](Edge e) { return Edge(e.o, e.i - low.first, e.j - low.second); };
+
+    size_t width = static_cast<size_t>(component.high.first - low.first + 1);
+    size_t height = static_cast<size_t>(component.high.second - low.second + 1);
+    Board local_board(width, height);
+    Coloring local_coloring(width, height);
+
+    // The bounding box may overlap other components: copy only the cells reachable from the seed.
+    std::vector<coord_type> cells;
+    std::vector<coord_type> stack;
+    stack.push_back(component.seed);
+    local_board.add_cell(to_local(component.seed));
+    while (!stack.empty()) {
+        auto current = stack.back();
+        stack.pop_back();
+        cells.push_back(current);
+        for (auto n: board.neighbors(current)) {
+            if (!local_board.in_polygon(to_local(n))) {
+                local_board.add_cell(to_local(n));
+                stack.push_back(n);
             }
         }
     }
-};
\ No newline at end of file
+
+    for (auto c: cells) {
+        for (auto e: adjacent_edges(c)) {
+            int color = lookup_color(coloring, e);
+            if (color != UNCOLORED)
+                set_color(local_coloring, to_local_edge(e), color);
+        }
+    }
+
+    Component local_component = component;
+    local_component.seed = to_local(component.seed);
+    local_component.low = std::make_pair(0, 0);
+    local_component.high = to_local(component.high);
+    local_component.block = to_local(component.block);
+    local_component.origin = std::make_pair(component.origin.first + low.first, component.origin.second + low.second);
+    complete_component(gen, local_board, CellGraph(local_board), local_coloring, local_component, pool);
+
+    for (auto c: cells) {
+        for (auto e: adjacent_edges(c))
+            set_color(coloring, e, lookup_color(local_coloring, to_local_edge(e)));
+    }
+}
+
+template<typename Generation>
+void complete_coloring_locally (Generation& gen, Board& board, Coloring& coloring){
+    for (const auto& component: label_components(board))
+        complete_component_locally(gen, board, coloring, component);
+    board.set_all_to_tiled();
+}
+
+template<int Colors>
+void complete_coloring_parallel (unsigned seed, unsigned threads, Board& board, Coloring& coloring, const ParallelThresholds& thresholds){
+    auto components = label_components(board);
+
+    // Largest components first, so that a huge one does not start last and leave the other threads idle.
+    std::vector<size_t> order(components.size());
+    for (size_t index = 0; index < order.size(); ++index)
+        order[index] = index;
+    std::stable_sort(order.begin(), order.end(), [&components](size_t a, size_t b) {
+        return components[a].cell_count > components[b].cell_count;
+    });
+
+    ThreadPool pool(threads, thresholds);
+    TaskGroup tasks(pool);
+    for (auto index: order) {
+        const Component& component = components[index];
+        tasks.run([seed, &pool, &board, &coloring, &component]() {
+            // Each component draws from its own stream, so the result does not depend on scheduling.
+            Philox4x32 stream(seed, static_cast<uint32_t>(component.id), board.to_index(component.seed));
+            StreamColorGeneration<Colors> gen(stream);
+            complete_component_locally(gen, board, coloring, component, &pool);
+        });
+    }
+    tasks.wait();
+
+    board.set_all_to_tiled();
+}
+
+#define INSTANTIATE_ENGINE(Colors, Engine) \
+    template void complete_component(BasicColorGeneration<Colors, Engine>& gen, Board& board, const CellGraph& graph, Coloring& coloring, const Component& component, ThreadPool* pool); \
+    template void complete_coloring(BasicColorGeneration<Colors, Engine>& gen, Board& board, Coloring& coloring); \
+    template void complete_component_locally(BasicColorGeneration<Colors, Engine>& gen, const Board& board, Coloring& coloring, const Component& component, ThreadPool* pool); \
+    template void complete_coloring_locally(BasicColorGeneration<Colors, Engine>& gen, Board& board, Coloring& coloring);
+#define INSTANTIATE(Colors) \
+    LINEARWANG_FOR_EACH_ENGINE(INSTANTIATE_ENGINE, Colors) \
+    template void complete_coloring_parallel<Colors>(unsigned seed, unsigned threads, Board& board, Coloring& coloring, const ParallelThresholds& thresholds);
+LINEARWANG_FOR_EACH_COLOR_COUNT(INSTANTIATE)
+#undef INSTANTIATE
+#undef INSTANTIATE_ENGINE
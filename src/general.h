@@ -2,11 +2,35 @@
 #define LINEARWANG_GENERAL_H
 
 #include "board.h"
+#include "cell_graph.h"
 #include "coloring.h"
+#include "components.h"
 #include "wang.h"
+#include "thread_pool.h"
 
-std::vector<coord_type> find_cycle_by_dfs(Board& board);
+// Both fill cycle with the cells of a cycle in order, reusing its storage; find_cycle_by_dfs
+// leaves it empty when the component of first_cell has no cycle.
+void find_cycle_by_dfs(Board& board, const CellGraph& graph, coord_type first_cell, std::vector<coord_type>& cycle);
+void block_cycle(coord_type corner, std::vector<coord_type>& cycle);
 
-void complete_coloring (ColorGeneration gen, Board& board, Coloring& coloring);
+// The graph is built from the board once its components are labelled, and serves all of them.
+template<typename Generation>
+void complete_component (Generation& gen, Board& board, const CellGraph& graph, Coloring& coloring, const Component& component, ThreadPool* pool = nullptr);
+template<typename Generation>
+void complete_coloring (Generation& gen, Board& board, Coloring& coloring);
+
+// Solves the component on a private copy of its bounding box. The board is only read and
+// only the edges of the component's cells are written in the coloring, so distinct
+// components can be solved concurrently. Given a pool, long cycles are also solved in parallel.
+template<typename Generation>
+void complete_component_locally (Generation& gen, const Board& board, Coloring& coloring, const Component& component, ThreadPool* pool = nullptr);
+// Serial solver running every component on its local copy, as complete_coloring_parallel
+// does: thin components then keep their cells and edges in a few cache lines. The tiling is
+// the same as with complete_coloring.
+template<typename Generation>
+void complete_coloring_locally (Generation& gen, Board& board, Coloring& coloring);
+template<int Colors>
+void complete_coloring_parallel (unsigned seed, unsigned threads, Board& board, Coloring& coloring,
+                                 const ParallelThresholds& thresholds = ParallelThresholds());
 
 #endif //LINEARWANG_GENERAL_H
@@ -1,5 +1,9 @@
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
 #include "board.h"
 #include "general.h"
 #include "wang.h"
@@ -8,6 +12,47 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#ifndef LINEARWANG_DEFAULT_ENGINE
+#define LINEARWANG_DEFAULT_ENGINE "mt19937"
+#endif
+
+const std::vector<std::string> engine_names = {"mt19937", "xoshiro256", "pcg64", "splitmix64"};
+
+// Reads a positive decimal integer; anything else, sign and trailing characters included, is rejected.
+bool parse_positive(const std::string& text, int& value) {
+    if (text.empty() || !std::all_of(text.begin(), text.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); }))
+        return false;
+    long parsed = std::strtol(text.c_str(), nullptr, 10);
+    if (parsed < 1 || parsed > INT_MAX)
+        return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+template<typename Generation>
+void solve_serial(unsigned seed, bool local, Board& board, Coloring& coloring) {
+    Generation gen(seed);
+    if (local)
+        complete_coloring_locally(gen, board, coloring);
+    else
+        complete_coloring(gen, board, coloring);
+}
+
+// The engine is chosen once here; the solvers are instantiated for each of them.
+template<int Colors>
+void solve(unsigned seed, unsigned threads, bool local, const std::string& engine, Board& board, Coloring& coloring) {
+    if (threads > 0)
+        complete_coloring_parallel<Colors>(seed, threads, board, coloring);
+    else if (engine == "xoshiro256")
+        solve_serial<Xoshiro256Generation<Colors>>(seed, local, board, coloring);
+    else if (engine == "pcg64")
+        solve_serial<Pcg64Generation<Colors>>(seed, local, board, coloring);
+    else if (engine == "splitmix64")
+        solve_serial<SplitMix64Generation<Colors>>(seed, local, board, coloring);
+    else
+        solve_serial<ColorGeneration<Colors>>(seed, local, board, coloring);
+}
+
 int main(int argc, char* argv[]) {
 
     std::vector<std::string> arguments(argv + 1, argv + argc);
@@ -20,11 +65,72 @@ int main(int argc, char* argv[]) {
         arguments.erase(flagIt);
     }
 
-    if (arguments.size() != 1){
+    bool local = false;
+
+    auto localIt = std::find(arguments.begin(), arguments.end(), "--local");
+    if (localIt != arguments.end()){
+        local = true;
+        arguments.erase(localIt);
+    }
+
+    bool bad_value = false;
+    unsigned threads = 0;
+
+    auto threadsIt = std::find(arguments.begin(), arguments.end(), "--threads");
+    if (threadsIt != arguments.end() && threadsIt + 1 != arguments.end()){
+        int parsed = 0;
+        if (parse_positive(*(threadsIt + 1), parsed))
+            threads = static_cast<unsigned>(parsed);
+        else
+            bad_value = true;
+        arguments.erase(threadsIt, threadsIt + 2);
+    }
+
+    int colors = 3;
+
+    auto colorsIt = std::find(arguments.begin(), arguments.end(), "--colors");
+    if (colorsIt != arguments.end() && colorsIt + 1 != arguments.end()){
+        if (!parse_positive(*(colorsIt + 1), colors))
+            bad_value = true;
+        arguments.erase(colorsIt, colorsIt + 2);
+    }
+
+    std::string engine = LINEARWANG_DEFAULT_ENGINE;
+    bool engine_given = false;
+
+    auto engineIt = std::find(arguments.begin(), arguments.end(), "--engine");
+    if (engineIt != arguments.end() && engineIt + 1 != arguments.end()){
+        engine = *(engineIt + 1);
+        engine_given = true;
+        arguments.erase(engineIt, engineIt + 2);
+    }
+
+    bool known_engine = std::find(engine_names.begin(), engine_names.end(), engine) != engine_names.end();
+
+#ifdef LINEARWANG_MAP_COLORING
+    // MapColoring inserts an edge on its first write, so threads writing colors would race.
+    const bool threads_supported = false;
+#else
+    const bool threads_supported = true;
+#endif
+
+    // The threaded solver always uses Philox streams on local copies of the components.
+    bool serial_option_with_threads = threads > 0 && (local || engine_given);
+
+    if (arguments.size() != 1 || bad_value || (colors != 3 && colors != 4 && colors != 8) || !known_engine
+        || (threads > 0 && !threads_supported) || serial_option_with_threads){
         std::cout<<"Usage:\n";
-        std::cout<<"\t"<<argv[0]<<" [-ne] MASK\n";
+        std::cout<<"\t"<<argv[0]<<" [-ne] [--local] [--threads N] [--colors K] [--engine E] MASK\n";
         std::cout<<"where MASK is a png image.\n";
         std::cout<<"Use the flag \"-ne\" to remove the exterior in the output.\n";
+        std::cout<<"Use \"--local\" to solve each component on a compact copy of its bounding box.\n";
+        std::cout<<"Use \"--threads N\" to solve independent components on N >= 1 threads.\n";
+        if (!threads_supported)
+            std::cout<<"(\"--threads\" is unavailable in builds with LINEARWANG_MAP_COLORING.)\n";
+        std::cout<<"Use \"--colors K\" to tile with K = 3, 4 or 8 colors (3 by default).\n";
+        std::cout<<"Use \"--engine E\" to draw the serial solver's colors from E = mt19937, xoshiro256,\n";
+        std::cout<<"pcg64 or splitmix64 ("<<LINEARWANG_DEFAULT_ENGINE<<" by default). Threads always use Philox streams,\n";
+        std::cout<<"so \"--engine\" and \"--local\" cannot be combined with \"--threads\".\n";
         return 1;
     }
 
@@ -50,9 +156,9 @@ int main(int argc, char* argv[]) {
 
     stbi_image_free(data);
 
-    ColorGeneration gen(1234, 3);
+    unsigned seed = 1234;
 
-    Coloring c;
+    Coloring c(b.width(), b.height());
 
     b.edge_iter([&b, &c](Edge e) { if (b.is_boundary_edge(e)) set_color(c, e, 0); });
 
@@ -69,8 +175,12 @@ int main(int argc, char* argv[]) {
     });
 
 
-    complete_coloring(gen, b, c);
+    switch (colors) {
+        case 4: solve<4>(seed, threads, local, engine, b, c); break;
+        case 8: solve<8>(seed, threads, local, engine, b, c); break;
+        default: solve<3>(seed, threads, local, engine, b, c); break;
+    }
 
-    output_tiling(b, c, 3, 20, "out.svg", exterior_output);
+    output_tiling(b, c, colors, 20, "out.svg", exterior_output);
     return 0;
 }
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include "output.h"
@@ -24,9 +25,9 @@ void print_square(std::ofstream& out, int x1, int y1, int x2, int y2, const std:
     out << "\"/>\n";
 }
 
-void print_tile(std::ofstream& out, Coloring& coloring, coord_type c, unsigned unit_size, int max_color){
+void print_tile(std::ofstream& out, const Coloring& coloring, coord_type c, unsigned unit_size, int max_color){
     tile t = get_tile(coloring, c);
-    if (std::count(t.begin(), t.end(), -1) > 0) {
+    if (std::count(t.begin(), t.end(), UNCOLORED) > 0) {
         std::cerr << "Incomplete tile in "<<c<<'\n';
     } else if ((t[0] == t[2]) == (t[1] == t[3])) {
         std::cerr << "Invalid tile in "<<c<<'\n';
@@ -64,7 +65,7 @@ void print_cell(std::ofstream& out, coord_type c, unsigned unit_size){
     print_square(out, x, y, xx, yy, "#000000", 2);
 }
 
-void output_tiling(const Board& board, Coloring& coloring, int max_color, unsigned size_unit, const std::string& filename, bool exterior_output){
+void output_tiling(const Board& board, const Coloring& coloring, int max_color, unsigned size_unit, const std::string& filename, bool exterior_output){
     std::ofstream ofs;
 
     ofs.open(filename);
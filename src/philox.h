@@ -0,0 +1,80 @@
+#ifndef LINEARWANG_PHILOX_H
+#define LINEARWANG_PHILOX_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Counter-based generator Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy
+// as 1, 2, 3", SC'11). Every output block is a pure function of the key and a 128-bit
+// counter, so independent streams are obtained by fixing part of the counter instead of
+// by seeding a stateful engine. Here the key is the seed and the counter holds the
+// component id and a cell index, followed by the position in the stream.
+class Philox4x32 {
+public:
+    typedef uint32_t result_type;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return 0xffffffff; }
+
+    explicit Philox4x32(uint64_t seed, uint32_t component = 0, uint64_t cell = 0)
+            : m_key {{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)}}
+            , m_counter {{0, static_cast<uint32_t>(cell), static_cast<uint32_t>(cell >> 32), component}}
+            , m_output()
+            , m_next(4) {}
+
+    result_type operator()() {
+        if (m_next == 4) {
+            m_output = block(m_counter, m_key);
+            ++m_counter[0];
+            m_next = 0;
+        }
+        return m_output[m_next++];
+    }
+
+    // Writes the next n / 2 blocks as n 64-bit words, n being even. The blocks do not
+    // depend on each other, so the loop vectorizes.
+    void fill(uint64_t* out, size_t n) {
+        for (size_t k = 0; k < n / 2; ++k) {
+            std::array<uint32_t, 4> counter = m_counter;
+            counter[0] += static_cast<uint32_t>(k);
+            std::array<uint32_t, 4> r = block(counter, m_key);
+            out[2 * k] = r[0] | (static_cast<uint64_t>(r[1]) << 32);
+            out[2 * k + 1] = r[2] | (static_cast<uint64_t>(r[3]) << 32);
+        }
+        m_counter[0] += static_cast<uint32_t>(n / 2);
+        m_next = 4;
+    }
+
+    // Stream of the same key and component labelled by another cell index, from its start.
+    Philox4x32 substream(uint64_t cell) const {
+        uint64_t seed = m_key[0] | (static_cast<uint64_t>(m_key[1]) << 32);
+        return Philox4x32(seed, m_counter[3], cell);
+    }
+
+    static std::array<uint32_t, 4> block(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key) {
+        for (int round = 0; round < 10; ++round) {
+            if (round > 0) {
+                key[0] += 0x9E3779B9;
+                key[1] += 0xBB67AE85;
+            }
+            uint64_t p0 = uint64_t(0xD2511F53) * counter[0];
+            uint64_t p1 = uint64_t(0xCD9E8D57) * counter[2];
+            counter = {{
+                static_cast<uint32_t>(p1 >> 32) ^ counter[1] ^ key[0],
+                static_cast<uint32_t>(p1),
+                static_cast<uint32_t>(p0 >> 32) ^ counter[3] ^ key[1],
+                static_cast<uint32_t>(p0)
+            }};
+        }
+        return counter;
+    }
+
+private:
+    std::array<uint32_t, 2> m_key;
+    std::array<uint32_t, 4> m_counter;
+    std::array<uint32_t, 4> m_output;
+    int m_next;
+};
+
+#endif //LINEARWANG_PHILOX_H
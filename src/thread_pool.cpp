@@ -0,0 +1,126 @@
+#include "thread_pool.h"
+
+namespace {
+
+// Queue owned by the current thread, if it belongs to a pool.
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_queue = 0;
+
+}
+
+ThreadPool::ThreadPool(unsigned threads, const ParallelThresholds& thresholds)
+        : m_thresholds(thresholds), m_next_queue(0), m_queued(0), m_stop(false) {
+    if (threads == 0)
+        threads = 1;
+    for (unsigned index = 0; index < threads; ++index)
+        m_queues.emplace_back(new Queue());
+
+    current_pool = this;
+    current_queue = 0;
+    for (unsigned index = 1; index < threads; ++index)
+        m_workers.emplace_back([this, index]() { worker_loop(index); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto& worker: m_workers)
+        worker.join();
+    if (current_pool == this)
+        current_pool = nullptr;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    // Counted before it is queued so that the counter cannot underflow when a thief takes it at once.
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+        ++m_queued;
+    }
+    if (current_pool == this && current_queue != 0) {
+        Queue& q = *m_queues[current_queue];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.tasks.push_front(std::move(task));
+    } else {
+        Queue& q = *m_queues[m_next_queue++ % m_queues.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.tasks.push_back(std::move(task));
+    }
+    m_wake.notify_one();
+}
+
+bool ThreadPool::pop_task(size_t own, std::function<void()>& task) {
+    {
+        Queue& q = *m_queues[own];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty()) {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            --m_queued;
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < m_queues.size(); ++offset) {
+        Queue& q = *m_queues[(own + offset) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty()) {
+            task = std::move(q.tasks.back());
+            q.tasks.pop_back();
+            --m_queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::worker_loop(size_t index) {
+    current_pool = this;
+    current_queue = index;
+    while (true) {
+        std::function<void()> task;
+        if (pop_task(index, task)) {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleep_mutex);
+        m_wake.wait(lock, [this]() { return m_stop || m_queued > 0; });
+        if (m_stop)
+            return;
+    }
+}
+
+bool TaskGroup::State::run_one() {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tasks.empty())
+            return false;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+    }
+    task();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--unfinished == 0)
+        finished.notify_all();
+    return true;
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->tasks.push_back(std::move(task));
+        ++m_state->unfinished;
+    }
+    // A ticket whose task was taken by the waiting thread does nothing.
+    std::shared_ptr<State> state = m_state;
+    m_pool.submit([state]() { state->run_one(); });
+}
+
+void TaskGroup::wait() {
+    while (m_state->run_one()) {
+    }
+    std::unique_lock<std::mutex> lock(m_state->mutex);
+    m_state->finished.wait(lock, [this]() { return m_state->unfinished == 0; });
+}
@@ -0,0 +1,91 @@
+#ifndef LINEARWANG_THREAD_POOL_H
+#define LINEARWANG_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Sizes from which the solvers cut their work into tasks of a pool. The program keeps the
+// defaults; tests lower them to run the parallel paths on small boards. The colors depend
+// on them, but not on the number of threads.
+struct ParallelThresholds {
+    size_t cycle_length = 1 << 14;  // primitive cells of a cycle propagated by a parallel scan
+    size_t chain_block = 1 << 12;   // cells of a chain composed by one task
+    size_t fork_size = 1 << 13;     // cells of the smallest subtree of a tree solved as a task of its own
+    size_t subtree_cells = 1 << 14; // cells of a cyclic component completing its hanging subtrees in parallel
+    size_t subtree_batch = 1 << 12; // cells of a batch of whole hanging subtrees completed by one task
+};
+
+// Work-stealing pool. Every thread owns a queue: tasks submitted from a worker go to the
+// front of its own queue and are taken back from the front, tasks submitted from outside
+// are dealt round-robin to the back of the queues. Idle threads steal from the back of the
+// other queues. The thread which created the pool counts as one of its threads and runs
+// the tasks of the groups it waits for.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads, const ParallelThresholds& thresholds = ParallelThresholds());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(m_queues.size()); }
+
+    const ParallelThresholds& thresholds() const { return m_thresholds; }
+
+    void submit(std::function<void()> task);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool pop_task(size_t own, std::function<void()>& task);
+    void worker_loop(size_t index);
+
+    ParallelThresholds m_thresholds;
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::atomic<size_t> m_next_queue;
+    std::atomic<size_t> m_queued;
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_wake;
+    bool m_stop;
+};
+
+// Set of tasks which can be waited for together. Tasks may themselves run nested groups.
+// The group keeps its tasks and the pool only queues a ticket for each, with which a worker
+// runs the oldest task of the group left, if any. A thread waiting for the group runs its
+// tasks too but none of other groups, so a wait never nests deeper than the groups do;
+// once they are all taken, it sleeps until the last one ends.
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool): m_pool(pool), m_state(std::make_shared<State>()) {}
+    ~TaskGroup() { wait(); }
+
+    void run(std::function<void()> task);
+    void wait();
+
+private:
+    // Shared with the tickets, which may outlive the group.
+    struct State {
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::deque<std::function<void()>> tasks;
+        size_t unfinished = 0;      // tasks queued or running
+
+        // Runs the oldest queued task on the calling thread, if there is one.
+        bool run_one();
+    };
+
+    ThreadPool& m_pool;
+    std::shared_ptr<State> m_state;
+};
+
+#endif //LINEARWANG_THREAD_POOL_H
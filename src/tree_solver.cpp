@@ -1,137 +1,448 @@
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include "tree_solver.h"
 #include "wang.h"
 
+// Constraint on the color of an edge, packed in one byte: 0 for any color, 1 + c for
+// exactly c, and 1 + Colors + c for any color but c.
+template<int Colors>
 struct Constraint {
-    enum { Any, Strict, Diff } type;
-    int color;
+    static constexpr int values = 2 * Colors + 1;
 
-    static Constraint star() {
-        Constraint s;
-        s.type = Any;
-        s.color = -1;
-        return s;
-    }
+    uint8_t code;
 
-    static Constraint strict(int c) {
-        Constraint s;
-        s.type = Strict;
-        s.color = c;
-        return s;
-    }
+    static constexpr Constraint star() { return Constraint{0}; }
+    static constexpr Constraint strict(int c) { return Constraint{static_cast<uint8_t>(1 + c)}; }
+    static constexpr Constraint diff(int c) { return Constraint{static_cast<uint8_t>(1 + Colors + c)}; }
 
-    static Constraint diff(int c) {
-        Constraint s;
-        s.type = Diff;
-        s.color = c;
-        return s;
-    }
+    constexpr bool is_any() const { return code == 0; }
+    constexpr bool is_strict() const { return code >= 1 && code <= Colors; }
+    constexpr bool is_diff() const { return code > Colors; }
+    constexpr int color() const { return is_strict() ? code - 1 : is_diff() ? code - 1 - Colors : -1; }
 };
 
-Constraint inv(Constraint c){
-    if (c.type == Constraint::Diff || c.type == Constraint::Any)
-        return Constraint::star();
-    return Constraint::diff(c.color);
+namespace reference {
+
+// Definitions of the constraint operations, evaluated only to fill the tables below.
+
+template<int Colors>
+constexpr Constraint<Colors> inv(Constraint<Colors> c){
+    if (c.is_diff() || c.is_any())
+        return Constraint<Colors>::star();
+    return Constraint<Colors>::diff(c.color());
 }
 
-Constraint propagate(Constraint a, Constraint b, Constraint c){
-    if (c.type == Constraint::Any || a.type == Constraint::Any || b.type == Constraint::Any)
-        return Constraint::star();
-    if (a.type == Constraint::Diff && b.type == Constraint::Diff)
-        return Constraint::star();
+template<int Colors>
+constexpr Constraint<Colors> propagate(Constraint<Colors> a, Constraint<Colors> b, Constraint<Colors> c){
+    if (c.is_any() || a.is_any() || b.is_any())
+        return Constraint<Colors>::star();
+    if (a.is_diff() && b.is_diff())
+        return Constraint<Colors>::star();
 
-    if (a.type == Constraint::Strict && b.type == Constraint::Strict){
-        if (a.color == b.color)
-            return inv(c);
+    if (a.is_strict() && b.is_strict()){
+        if (a.color() == b.color())
+            return reference::inv(c);
         else
             return c;
     }
 
-    if (a.color == b.color)
+    if (a.color() == b.color())
         return c;
     else
-        return Constraint::star();
+        return Constraint<Colors>::star();
 }
 
-bool compatible(Constraint a, Constraint b){
-    if (a.type == Constraint::Any || b.type == Constraint::Any) return true;
-    if (a.type == Constraint::Diff && b.type == Constraint::Diff) return true;
+template<int Colors>
+constexpr bool compatible(Constraint<Colors> a, Constraint<Colors> b){
+    if (a.is_any() || b.is_any()) return true;
+    if (a.is_diff() && b.is_diff()) return true;
 
-    if (a.type == b.type) {
-        return a.color == b.color;
+    if (a.is_strict() == b.is_strict()) {
+        return a.color() == b.color();
     } else
-        return a.color != b.color;
-}
-
-Constraint propagate_constraint_from_leaves(
-        Board& board
-        , Coloring& coloring
-        , std::set<Edge, EdgeLess> visited
-        , std::map<Edge, Constraint, EdgeLess>& constraints
-        , coord_type child){
-
-    std::array<Edge, 3> to_visit {{bottom(child), left(child), right(child)}};
-
-    if (visited.count(top(child))){
-        to_visit = {{bottom(child), left(child), right(child)}};
-    } else if (visited.count(bottom(child))) {
-        to_visit = {{top(child), left(child), right(child)}};
-    } else if (visited.count(left(child))) {
-        to_visit = {{right(child), top(child), bottom(child)}};
-    } else if (visited.count(right(child))) {
-        to_visit = {{left(child), top(child), bottom(child)}};
-    } else {
-        std::cerr << "No previously visited node in propagating constraint for cell "<<child<<'\n';
-        exit(1);
+        return a.color() != b.color();
+}
+
+}
+
+// How to draw a color meeting two compatible constraints.
+struct DualSolution {
+    enum Kind : uint8_t { Fixed, AnyColor, DifferentFromOne, DifferentFromTwo } kind;
+    int8_t first;
+    int8_t second;
+};
+
+template<int Colors>
+constexpr DualSolution dual_solution(Constraint<Colors> c1, Constraint<Colors> c2){
+    if (c1.is_any() && c2.is_any())
+        return DualSolution{DualSolution::AnyColor, -1, -1};
+    if (c1.is_any())
+        return dual_solution(c2, c1);
+    if (c2.is_any() && c1.is_diff())
+        return DualSolution{DualSolution::DifferentFromOne, static_cast<int8_t>(c1.color()), -1};
+    if (c1.is_strict())
+        return DualSolution{DualSolution::Fixed, static_cast<int8_t>(c1.color()), -1};
+    if (c2.is_strict())
+        return DualSolution{DualSolution::Fixed, static_cast<int8_t>(c2.color()), -1};
+    return DualSolution{DualSolution::DifferentFromTwo, static_cast<int8_t>(c1.color()), static_cast<int8_t>(c2.color())};
+}
+
+// The constraint operations for every combination of packed codes.
+template<int Colors>
+struct ConstraintTables {
+    static constexpr int values = Constraint<Colors>::values;
+
+    uint8_t inv[values];
+    uint8_t propagate[values][values][values];
+    bool compatible[values][values];
+    DualSolution dual[values][values];
+
+    constexpr ConstraintTables(): inv(), propagate(), compatible(), dual() {
+        for (int a = 0; a < values; ++a) {
+            Constraint<Colors> ca{static_cast<uint8_t>(a)};
+            inv[a] = reference::inv(ca).code;
+            for (int b = 0; b < values; ++b) {
+                Constraint<Colors> cb{static_cast<uint8_t>(b)};
+                compatible[a][b] = reference::compatible(ca, cb);
+                dual[a][b] = dual_solution(ca, cb);
+                for (int c = 0; c < values; ++c)
+                    propagate[a][b][c] = reference::propagate(ca, cb, Constraint<Colors>{static_cast<uint8_t>(c)}).code;
+            }
+        }
     }
+};
 
-    std::array<Constraint, 3> prop_constraints;
-    for(size_t index = 0; index < 3 ; ++index) {
-        int c = get_color(coloring, to_visit[index]);
-        if (c > -1){
-            prop_constraints[index] = Constraint::strict(c);
-        } else {
-            visited.insert(to_visit[index]);
-            auto next = first(to_visit[index]);
-            if (next == child)
-                next = second(to_visit[index]);
-            prop_constraints[index] = propagate_constraint_from_leaves(board, coloring, visited, constraints, next);
-            constraints[to_visit[index]] = prop_constraints[index];
+template<int Colors>
+constexpr ConstraintTables<Colors> constraint_tables {};
+
+template<int Colors>
+Constraint<Colors> inv(Constraint<Colors> c){
+    return Constraint<Colors>{constraint_tables<Colors>.inv[c.code]};
+}
+
+template<int Colors>
+Constraint<Colors> propagate(Constraint<Colors> a, Constraint<Colors> b, Constraint<Colors> c){
+    return Constraint<Colors>{constraint_tables<Colors>.propagate[a.code][b.code][c.code]};
+}
+
+template<int Colors>
+bool compatible(Constraint<Colors> a, Constraint<Colors> b){
+    return constraint_tables<Colors>.compatible[a.code][b.code];
+}
+
+// Cell of the tree in DFS pre-order. Sides are numbered as in adjacent_edges: top, left, bottom, right.
+struct TreeNode {
+    coord_type cell;
+    size_t parent;      // position of the parent in the pre-order
+    int parent_side;    // side of the cell facing its parent, -1 for the root
+};
+
+// Buffers of the tree solver, kept from one tree to the next so that each thread allocates
+// them once. Every uncolored edge of a tree is written in the constraint planes before it is
+// read, so they are never cleared.
+template<int Colors>
+struct TreeWorkspace {
+    std::vector<TreeNode> nodes;
+    std::vector<TreeNode> stack;
+    EdgePlanes<Constraint<Colors>> constraints;     // constraint imposed by the subtree hanging below each tree edge
+};
+
+template<int Colors>
+Constraint<Colors> side_constraint(const Coloring& coloring, const EdgePlanes<Constraint<Colors>>& constraints, coord_type cell, int side){
+    Edge e = side_edge(cell, side);
+    int c = lookup_color(coloring, e);
+    if (c != UNCOLORED)
+        return Constraint<Colors>::strict(c);
+    return constraints[e];
+}
+
+// The tree is a whole component, so the children of a cell are its neighbors in the cell
+// graph other than its parent. Children are visited top, left, bottom, right, the order in
+// which solutions are drawn.
+template<int Colors>
+void tree_preorder(const CellGraph& graph, coord_type root, TreeWorkspace<Colors>& workspace){
+    std::vector<TreeNode>& nodes = workspace.nodes;
+    std::vector<TreeNode>& stack = workspace.stack;
+    nodes.clear();
+    stack.push_back(TreeNode{root, 0, -1});
+
+    while (!stack.empty()) {
+        TreeNode node = stack.back();
+        stack.pop_back();
+        size_t position = nodes.size();
+        nodes.push_back(node);
+
+        int mask = graph.mask(graph.id(node.cell));
+        for (int side = 3; side >= 0; --side) {
+            if (side == node.parent_side || !(mask & (1 << side)))
+                continue;
+            stack.push_back(TreeNode{across_side(node.cell, side), position, (side + 2) % 4});
         }
     }
+}
 
-    return propagate(prop_constraints[1], prop_constraints[2], prop_constraints[0]);
+// Writes the constraint the subtree of the node at position imposes on the edge to its parent.
+template<int Colors>
+void propagate_up(const Coloring& coloring, TreeWorkspace<Colors>& workspace, size_t position){
+    const TreeNode& node = workspace.nodes[position];
+    EdgePlanes<Constraint<Colors>>& constraints = workspace.constraints;
+    int p = node.parent_side;
+    constraints[side_edge(node.cell, p)] = propagate(
+            side_constraint(coloring, constraints, node.cell, (p + 1) % 4),
+            side_constraint(coloring, constraints, node.cell, (p + 3) % 4),
+            side_constraint(coloring, constraints, node.cell, (p + 2) % 4));
 }
 
-int solve_constraint(ColorGeneration g, Constraint c){
-    if (c.type == Constraint::Any)
-        return g.pick_color();
-    if (c.type == Constraint::Diff)
-        return g.pick_different_color(c.color);
-    return c.color;
+// Children come after their parent in the pre-order, so a reverse sweep sees every subtree
+// complete before the cell it hangs from. A subtree occupies a range [begin, end) of positions.
+template<int Colors>
+void propagate_constraint_from_leaves(const Coloring& coloring, TreeWorkspace<Colors>& workspace, size_t begin, size_t end){
+    for (size_t position = end; position-- > std::max<size_t>(begin, 1);)
+        propagate_up(coloring, workspace, position);
 }
 
-int solve_dual_constraints(ColorGeneration g, Constraint c1, Constraint c2){
-    // The two constraints are assumed compatible.
-    if (c1.type == Constraint::Any)
-        return solve_constraint(g, c2);
-    if (c2.type == Constraint::Any)
-        return solve_constraint(g, c1);
+// Colors the uncolored sides of the cell of node from the constraints, see below.
+template<typename Generation>
+void solve_node(Generation& g, Coloring& coloring, const TreeWorkspace<Generation::bound()>& workspace, const TreeNode& node);
+
+// Streams of the subtrees colored as tasks are labelled by their top cell with this bit set,
+// so they never meet the stream of a component, labelled by its seed cell.
+const uint64_t tree_stream = uint64_t(1) << 62;
+
+// Task-parallel version of propagate_constraint_from_leaves, writing the same constraints.
+// The tree is cut into heavy paths, following the largest child from each cell. Once the
+// subtrees hanging off a path are done, the constraint of each cell of the path is a map
+// of the one of the next cell, and the chain of maps is evaluated with a parallel scan.
+// Subtrees hanging off a path are contracted as tasks, recursively for the large ones.
+template<int Colors>
+class TreeContraction {
+public:
+    TreeContraction(const Coloring& coloring, TreeWorkspace<Colors>& workspace, ThreadPool& pool)
+            : m_coloring(coloring), m_workspace(workspace), m_pool(pool)
+            , fork_size(pool.thresholds().fork_size), chain_block(pool.thresholds().chain_block)
+            , m_size(workspace.nodes.size(), 1), m_heavy(workspace.nodes.size(), 0) {
+        const std::vector<TreeNode>& nodes = workspace.nodes;
+        for (size_t position = nodes.size(); position-- > 1;) {
+            size_t parent = nodes[position].parent;
+            m_size[parent] += m_size[position];
+            if (m_heavy[parent] == 0 || m_size[position] > m_size[m_heavy[parent]])
+                m_heavy[parent] = position;
+        }
+    }
+
+    void run() {
+        contract(0);
+    }
+
+    // Top-down pass, drawing the colors once the constraints are written. A cell only reads
+    // the edge to its parent, so once the parent is colored, the subtree of a light child
+    // of at least fork_size cells is colored as a task. Each such subtree draws from its own
+    // generation, split from g in pre-order, and they are chosen by size alone: the colors
+    // do not depend on the number of threads. Heavy paths stay in the task of their top.
+    template<typename Generation>
+    void propagate_solution(Generation& g, const Board& board, Coloring& coloring) {
+        const std::vector<TreeNode>& nodes = m_workspace.nodes;
+        m_forks.clear();
+        for (size_t position = 1; position < nodes.size(); ++position)
+            if (m_size[position] >= fork_size && position != m_heavy[nodes[position].parent])
+                m_forks.push_back(position);
+
+        std::vector<typename Generation::engine_type> engines;
+        engines.reserve(m_forks.size());
+        for (size_t position: m_forks)
+            engines.push_back(g.split(tree_stream | board.to_index(nodes[position].cell)));
+        solve_subtree(g, coloring, engines, 0);
+    }
+
+private:
+    // One cell of a heavy path: its constraint is propagate(args) with args[variable]
+    // replaced by the constraint of the next cell of the path.
+    struct Link {
+        std::array<Constraint<Colors>, 3> args;
+        int variable;
+
+        Constraint<Colors> apply(Constraint<Colors> x) const {
+            std::array<Constraint<Colors>, 3> a = args;
+            a[variable] = x;
+            return propagate(a[0], a[1], a[2]);
+        }
+    };
+
+    void contract(size_t top) {
+        std::vector<size_t> path;
+        for (size_t position = top; ; position = m_heavy[position]) {
+            path.push_back(position);
+            if (m_size[position] == 1)
+                break;
+        }
+
+        // Subtrees hanging off the path. Small ones are batched so that each task has work.
+        {
+            TaskGroup tasks(m_pool);
+            std::vector<size_t> batch;
+            size_t batch_size = 0;
+            for (size_t position: path) {
+                size_t end = position + m_size[position];
+                for (size_t child = position + 1; child < end; child += m_size[child]) {
+                    if (child == m_heavy[position])
+                        continue;
+                    if (m_size[child] >= fork_size) {
+                        tasks.run([this, child]() { contract(child); });
+                        continue;
+                    }
+                    batch.push_back(child);
+                    batch_size += m_size[child];
+                    if (batch_size >= fork_size) {
+                        tasks.run([this, batch]() { contract_small(batch); });
+                        batch.clear();
+                        batch_size = 0;
+                    }
+                }
+            }
+            contract_small(batch);
+        }
 
-    if (c1.type == Constraint::Strict)
-        return c1.color;
-    if (c2.type == Constraint::Strict)
-        return c2.color;
+        // The root has no parent edge to write.
+        size_t first = top == 0 ? 1 : 0;
+        size_t last = path.size() - 1;
+        if (last < first)
+            return;
+        propagate_up(m_coloring, m_workspace, path[last]);
+        if (last - first < 2 * chain_block) {
+            for (size_t index = last; index-- > first;)
+                propagate_up(m_coloring, m_workspace, path[index]);
+            return;
+        }
+
+        std::vector<Link> links(last);
+        for (size_t index = first; index < last; ++index)
+            links[index] = link(path[index], path[index + 1]);
+
+        // Blocks of the chain, from the top: each composes its maps, then, once the constraints
+        // entering the blocks from below are known, writes those of its cells.
+        typedef std::array<Constraint<Colors>, Constraint<Colors>::values> Map;
+        size_t blocks = (last - first + chain_block - 1) / chain_block;
+        auto block_begin = [this, first](size_t block) { return first + block * chain_block; };
+        auto block_end = [this, first, last](size_t block) { return std::min(last, first + (block + 1) * chain_block); };
+        std::vector<Map> maps(blocks);
+        {
+            TaskGroup tasks(m_pool);
+            for (size_t block = 0; block < blocks; ++block) {
+                tasks.run([&, block]() {
+                    Map& map = maps[block];
+                    for (int x = 0; x < Constraint<Colors>::values; ++x)
+                        map[x] = Constraint<Colors>{static_cast<uint8_t>(x)};
+                    for (size_t index = block_end(block); index-- > block_begin(block);) {
+                        for (auto& c: map)
+                            c = links[index].apply(c);
+                    }
+                });
+            }
+        }
+
+        EdgePlanes<Constraint<Colors>>& constraints = m_workspace.constraints;
+        const std::vector<TreeNode>& nodes = m_workspace.nodes;
+        std::vector<Constraint<Colors>> block_in(blocks);
+        Constraint<Colors> below = constraints[side_edge(nodes[path[last]].cell, nodes[path[last]].parent_side)];
+        for (size_t block = blocks; block-- > 0;) {
+            block_in[block] = below;
+            below = maps[block][below.code];
+        }
+
+        TaskGroup tasks(m_pool);
+        for (size_t block = 0; block < blocks; ++block) {
+            tasks.run([&, block]() {
+                Constraint<Colors> c = block_in[block];
+                for (size_t index = block_end(block); index-- > block_begin(block);) {
+                    c = links[index].apply(c);
+                    const TreeNode& node = nodes[path[index]];
+                    constraints[side_edge(node.cell, node.parent_side)] = c;
+                }
+            });
+        }
+        tasks.wait();
+    }
+
+    template<typename Generation>
+    void solve_subtree(Generation& g, Coloring& coloring, const std::vector<typename Generation::engine_type>& engines, size_t top) {
+        TaskGroup tasks(m_pool);
+        for (size_t position = top, end = top + m_size[top]; position < end;) {
+            auto fork = std::lower_bound(m_forks.begin(), m_forks.end(), position);
+            if (position != top && fork != m_forks.end() && *fork == position) {
+                size_t index = static_cast<size_t>(fork - m_forks.begin());
+                tasks.run([this, &coloring, &engines, index, position]() {
+                    Generation fork_gen(engines[index]);
+                    solve_subtree(fork_gen, coloring, engines, position);
+                });
+                position += m_size[position];
+                continue;
+            }
+            solve_node(g, coloring, m_workspace, m_workspace.nodes[position]);
+            ++position;
+        }
+        tasks.wait();
+    }
 
-    return g.pick_different_color(c1.color, c2.color);
+    void contract_small(const std::vector<size_t>& subtrees) {
+        for (size_t child: subtrees)
+            propagate_constraint_from_leaves(m_coloring, m_workspace, child, child + m_size[child]);
+    }
+
+    Link link(size_t position, size_t next) const {
+        const TreeNode& node = m_workspace.nodes[position];
+        int p = node.parent_side;
+        int next_side = (m_workspace.nodes[next].parent_side + 2) % 4;
+        const int sides[3] = {(p + 1) % 4, (p + 3) % 4, (p + 2) % 4};
+        Link l;
+        for (int arg = 0; arg < 3; ++arg) {
+            if (sides[arg] == next_side)
+                l.variable = arg;
+            else
+                l.args[arg] = side_constraint(m_coloring, m_workspace.constraints, node.cell, sides[arg]);
+        }
+        l.args[l.variable] = Constraint<Colors>::star();
+        return l;
+    }
+
+    const Coloring& m_coloring;
+    TreeWorkspace<Colors>& m_workspace;
+    ThreadPool& m_pool;
+    const size_t fork_size;         // smallest subtree contracted or colored as a task of its own
+    const size_t chain_block;       // cells of a path composed by one task
+    std::vector<size_t> m_size;     // size of the subtree of each position
+    std::vector<size_t> m_heavy;    // position of the largest child, 0 for leaves
+    std::vector<size_t> m_forks;    // positions of the subtrees colored as tasks, in pre-order
+};
+
+template<typename Generation>
+using GenerationConstraint = Constraint<Generation::bound()>;
+
+template<typename Generation>
+int solve_dual_constraints(Generation& g, GenerationConstraint<Generation> c1, GenerationConstraint<Generation> c2){
+    // The two constraints are assumed compatible.
+    const DualSolution& s = constraint_tables<Generation::bound()>.dual[c1.code][c2.code];
+    switch (s.kind) {
+        case DualSolution::Fixed: return s.first;
+        case DualSolution::AnyColor: return g.pick_color();
+        case DualSolution::DifferentFromOne: return g.pick_different_color(s.first);
+        default: return g.pick_different_color(s.first, s.second);
+    }
 }
 
-std::array<int, 4> solve_constraints(ColorGeneration g, std::array<Constraint, 4> constraints){
+template<typename Generation>
+int solve_constraint(Generation& g, GenerationConstraint<Generation> c){
+    return solve_dual_constraints(g, c, GenerationConstraint<Generation>::star());
+}
+
+template<typename Generation>
+std::array<int, 4> solve_constraints(Generation& g, std::array<GenerationConstraint<Generation>, 4> constraints){
+    typedef GenerationConstraint<Generation> Constraint;
     int a = 0, b = 1, c = 2, d = 3;
     std::array<int, 4> solution;
     for(size_t index = 0 ; index < 4 ; ++index){
-        if (constraints[index].type == Constraint::Strict)
-            solution[index] = constraints[index].color;
+        if (constraints[index].is_strict())
+            solution[index] = constraints[index].color();
         else
             solution[index] = -1;
     }
@@ -171,57 +482,84 @@ std::array<int, 4> solve_constraints(ColorGeneration g, std::array<Constraint, 4
     return solution;
 };
 
-void propagate_solution(ColorGeneration g, Board& board, Coloring& coloring, std::map<Edge, Constraint, EdgeLess>& constraints, coord_type root){
-    std::array<Edge, 4> to_visit {{ top(root), left(root), bottom(root), right(root)}};
-
-    std::array<Constraint, 4> prop_constraints;
-    for(size_t index = 0; index < 4 ; ++index) {
-        int c = get_color(coloring, to_visit[index]);
-        if (c > -1){
-            prop_constraints[index] = Constraint::strict(c);
-        } else {
-            prop_constraints[index] = constraints.at(to_visit[index]);
-        }
-    }
+template<typename Generation>
+void solve_node(Generation& g, Coloring& coloring, const TreeWorkspace<Generation::bound()>& workspace, const TreeNode& node){
+    std::array<GenerationConstraint<Generation>, 4> prop_constraints;
+    for (int side = 0; side < 4; ++side)
+        prop_constraints[side] = side_constraint(coloring, workspace.constraints, node.cell, side);
 
     std::array<int, 4> solution = solve_constraints(g, prop_constraints);
-    for(size_t index = 0; index < 4 ; ++index) {
-        int c = get_color(coloring, to_visit[index]);
-        if (c == -1){
-            set_color(coloring, to_visit[index], solution[index]);
-            auto next = first(to_visit[index]);
-            if (next == root)
-                next = second(to_visit[index]);
-            propagate_solution(g, board, coloring, constraints, next);
-        }
+    for (int side = 0; side < 4; ++side) {
+        Edge e = side_edge(node.cell, side);
+        if (lookup_color(coloring, e) == UNCOLORED)
+            set_color(coloring, e, solution[side]);
     }
-    board.set_to_tiled(root);
 }
 
-bool solve_tree_from_root(ColorGeneration g, Board& board, Coloring& coloring, coord_type root){
+template<typename Generation>
+void propagate_solution(Generation& g, Board& board, Coloring& coloring, const TreeWorkspace<Generation::bound()>& workspace){
+    for (const auto& node: workspace.nodes) {
+        solve_node(g, coloring, workspace, node);
+        board.set_to_tiled(node.cell);
+    }
+}
 
-    std::set<Edge, EdgeLess> visited;
-    std::map<Edge, Constraint, EdgeLess> constraints;
+// The constraints of the subtrees around the root must leave it a tile.
+template<int Colors>
+bool root_is_solvable(const Coloring& coloring, const TreeWorkspace<Colors>& workspace, coord_type root){
+    std::array<Constraint<Colors>, 4> c;
+    for (int side = 0; side < 4; ++side)
+        c[side] = side_constraint(coloring, workspace.constraints, root, side);
+    return compatible(c[0], propagate(c[1], c[3], c[2]));
+}
 
-    std::array<Edge, 4> to_visit {{top(root), left(root), bottom(root), right(root)}};
-    std::array<Constraint, 4> prop_constraints;
-    for(size_t index = 0; index < 4 ; ++index) {
-        int c = get_color(coloring, to_visit[index]);
-        if (c > -1){
-            prop_constraints[index] = Constraint::strict(c);
-        } else {
-            visited.insert(to_visit[index]);
-            auto next = first(to_visit[index]);
-            if (next == root)
-                next = second(to_visit[index]);
-            prop_constraints[index] = propagate_constraint_from_leaves(board, coloring, visited, constraints, next);
-            constraints[to_visit[index]] = prop_constraints[index];
-        }
+template<typename Generation>
+bool solve_tree_from_root(Generation& g, Board& board, const CellGraph& graph, Coloring& coloring, coord_type root, ThreadPool* pool){
+    static thread_local TreeWorkspace<Generation::bound()> workspace;
+    workspace.constraints.reshape(board.width(), board.height());
+    tree_preorder(graph, root, workspace);
+    if (pool == nullptr || workspace.nodes.size() < pool->thresholds().fork_size) {
+        propagate_constraint_from_leaves(coloring, workspace, 0, workspace.nodes.size());
+        if (!root_is_solvable(coloring, workspace, root))
+            return false;
+        propagate_solution(g, board, coloring, workspace);
+        return true;
     }
 
-    if (compatible(prop_constraints[0], propagate(prop_constraints[1], prop_constraints[3], prop_constraints[2]))) {
-        propagate_solution(g, board, coloring, constraints, root);
-        return true;
-    } else
+    TreeContraction<Generation::bound()> contraction(coloring, workspace, *pool);
+    contraction.run();
+    if (!root_is_solvable(coloring, workspace, root))
         return false;
-}
\ No newline at end of file
+    contraction.propagate_solution(g, board, coloring);
+    // The board is a bitmap, shared between neighboring cells: update it from one thread.
+    for (const auto& node: workspace.nodes)
+        board.set_to_tiled(node.cell);
+    return true;
+}
+
+template<int Colors>
+std::vector<uint8_t> tree_edge_constraints(const Board& board, const CellGraph& graph, const Coloring& coloring, coord_type root, ThreadPool* pool){
+    TreeWorkspace<Colors> workspace;
+    workspace.constraints.reshape(board.width(), board.height());
+    tree_preorder(graph, root, workspace);
+    if (pool == nullptr)
+        propagate_constraint_from_leaves(coloring, workspace, 0, workspace.nodes.size());
+    else
+        TreeContraction<Colors>(coloring, workspace, *pool).run();
+
+    std::vector<uint8_t> codes;
+    for (size_t position = 1; position < workspace.nodes.size(); ++position) {
+        const TreeNode& node = workspace.nodes[position];
+        codes.push_back(workspace.constraints[side_edge(node.cell, node.parent_side)].code);
+    }
+    return codes;
+}
+
+#define INSTANTIATE_ENGINE(Colors, Engine) \
+    template bool solve_tree_from_root(BasicColorGeneration<Colors, Engine>& g, Board& board, const CellGraph& graph, Coloring& coloring, coord_type root, ThreadPool* pool);
+#define INSTANTIATE(Colors) \
+    LINEARWANG_FOR_EACH_ENGINE(INSTANTIATE_ENGINE, Colors) \
+    template std::vector<uint8_t> tree_edge_constraints<Colors>(const Board& board, const CellGraph& graph, const Coloring& coloring, coord_type root, ThreadPool* pool);
+LINEARWANG_FOR_EACH_COLOR_COUNT(INSTANTIATE)
+#undef INSTANTIATE
+#undef INSTANTIATE_ENGINE
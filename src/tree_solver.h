@@ -1,10 +1,24 @@
 #ifndef LINEARWANG_TREE_SOLVER_H
 #define LINEARWANG_TREE_SOLVER_H
 
+#include <cstdint>
+#include <vector>
 #include "board.h"
+#include "cell_graph.h"
 #include "coloring.h"
 #include "wang.h"
+#include "thread_pool.h"
 
-bool solve_tree_from_root(ColorGeneration g, Board& board, Coloring& coloring, coord_type root);
+// Given a pool, trees of at least its fork_size threshold are solved in parallel: their
+// large subtrees then draw from streams of their own, so the colors differ from the serial
+// solver's but not with the number of threads.
+template<typename Generation>
+bool solve_tree_from_root(Generation& g, Board& board, const CellGraph& graph, Coloring& coloring, coord_type root, ThreadPool* pool = nullptr);
+
+// Codes of the constraints the subtrees of the tree of root impose on the edges to their
+// parents, in pre-order, as the parallel contraction writes them given a pool and the
+// serial sweep otherwise. Used by the tests.
+template<int Colors>
+std::vector<uint8_t> tree_edge_constraints(const Board& board, const CellGraph& graph, const Coloring& coloring, coord_type root, ThreadPool* pool);
 
 #endif //LINEARWANG_TREE_SOLVER_H
@@ -1,6 +1,79 @@
+#include <cstdint>
 #include "wang.h"
 
-void ColorGeneration::complete_tile(tile& t){
+namespace {
+
+// Every partial tile, coded with one base Colors+1 digit per side (0 for an uncolored
+// side), mapped to the list of its valid completions. Each full tile is a completion of
+// its 16 partial tiles, which bounds the pool.
+template<int Colors>
+struct TileTable {
+    static constexpr int codes = (Colors + 1) * (Colors + 1) * (Colors + 1) * (Colors + 1);
+    static constexpr int pool_size = 16 * 2 * Colors * Colors * (Colors - 1);
+
+    uint16_t offset[codes];
+    uint16_t count[codes];
+    int8_t completions[pool_size][4];
+
+    constexpr TileTable(): offset(), count(), completions() {
+        // Counting sort of (partial tile, completion) pairs by partial tile code.
+        for (int pass = 0; pass < 2; ++pass) {
+            uint16_t filled[codes] = {};
+            for (int full = 0; full < Colors * Colors * Colors * Colors; ++full) {
+                int t[4] = {full % Colors, full / Colors % Colors, full / (Colors * Colors) % Colors, full / (Colors * Colors * Colors)};
+                if ((t[0] == t[2]) == (t[1] == t[3]))
+                    continue;
+                for (int known = 0; known < 16; ++known) {
+                    int code = 0;
+                    for (int side = 3; side >= 0; --side)
+                        code = code * (Colors + 1) + ((known >> side) & 1 ? t[side] + 1 : 0);
+                    if (pass == 0) {
+                        ++count[code];
+                    } else {
+                        int index = offset[code] + filled[code]++;
+                        for (int side = 0; side < 4; ++side)
+                            completions[index][side] = static_cast<int8_t>(t[side]);
+                    }
+                }
+            }
+            if (pass == 0) {
+                for (int code = 1; code < codes; ++code)
+                    offset[code] = static_cast<uint16_t>(offset[code - 1] + count[code - 1]);
+            }
+        }
+    }
+};
+
+template<int Colors>
+constexpr TileTable<Colors> tile_table {};
+
+}
+
+template<int Colors, typename Engine>
+void BasicColorGeneration<Colors, Engine>::complete_tile(tile& t){
+    // Plain engines keep the draws of the original algorithm, so that existing seeds give the
+    // same tiling. Both give every completion the same probability.
+    if (is_buffered<Engine>::value)
+        complete_tile_by_table(t);
+    else
+        complete_tile_by_draws(t);
+}
+
+template<int Colors, typename Engine>
+void BasicColorGeneration<Colors, Engine>::complete_tile_by_table(tile& t){
+    int code = 0;
+    for (int side = 3; side >= 0; --side)
+        code = code * (Colors + 1) + t[side] + 1;
+    int count = tile_table<Colors>.count[code];
+    if (count == 0)
+        return;
+    const int8_t* completion = tile_table<Colors>.completions[tile_table<Colors>.offset[code] + draw_below(rng, count)];
+    for (int side = 0; side < 4; ++side)
+        t[side] = completion[side];
+}
+
+template<int Colors, typename Engine>
+void BasicColorGeneration<Colors, Engine>::complete_tile_by_draws(tile& t){
     int a = 0, b=1, c=2, d=3;
     if (t[a] == -1) std::swap(a, c);
     if (t[b] == -1) std::swap(b, d);
@@ -23,7 +96,7 @@ void ColorGeneration::complete_tile(tile& t){
     if (t[b] == -1) t[b] = pick_color();
 
     if (t[c] == -1) {
-        if(std::uniform_real_distribution<>(0,1)(*rng.get()) > 0.5)
+        if(get() > 0.5)
             t[c] = t[a];
         else {
             t[c] = pick_different_color(t[a]);
@@ -37,4 +110,11 @@ void ColorGeneration::complete_tile(tile& t){
             t[d] = pick_different_color(t[b]);
         }
     }
-}
\ No newline at end of file
+}
+
+#define INSTANTIATE_ENGINE(Colors, Engine) \
+    template class BasicColorGeneration<Colors, Engine>;
+#define INSTANTIATE(Colors) LINEARWANG_FOR_EACH_ENGINE(INSTANTIATE_ENGINE, Colors)
+LINEARWANG_FOR_EACH_COLOR_COUNT(INSTANTIATE)
+#undef INSTANTIATE
+#undef INSTANTIATE_ENGINE
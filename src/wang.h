@@ -3,32 +3,125 @@
 
 #include <random>
 #include <array>
+#include "philox.h"
+#include "buffered_bits.h"
+#include "engines.h"
 
 typedef std::array<int, 4> tile;
 
-class ColorGeneration {
+// Uniform draws used by the color generation. Plain engines go through the standard
+// distributions, which keeps the sequences of existing seeds; buffered engines slice bits.
+template<typename Engine>
+inline int draw_below(Engine& engine, int n) {
+    return std::uniform_int_distribution<int>(0, n-1)(engine);
+}
+
+template<typename Engine>
+inline double draw_unit(Engine& engine) {
+    return std::uniform_real_distribution<>(0,1)(engine);
+}
+
+template<typename Engine>
+inline int draw_below(BufferedBits<Engine>& bits, int n) {
+    return bits.below(n);
+}
+
+template<typename Engine>
+inline double draw_unit(BufferedBits<Engine>& bits) {
+    return bits.unit();
+}
+
+// Engine of an independent stream labelled by index, e.g. for a task of its own. Philox
+// streams derive it from their counter, so it does not depend on the draws made so far.
+// Other engines are split from their state, never from fewer bits than it holds, so that
+// split streams do not meet. By default the child is seeded with 256 bits of draws.
+template<typename Engine>
+inline Engine split_engine(Engine& engine, uint64_t) {
+    std::array<uint32_t, 8> words;
+    for (auto& word: words)
+        word = static_cast<uint32_t>(engine());
+    std::seed_seq seeds(words.begin(), words.end());
+    return Engine(seeds);
+}
+
+inline Philox4x32 split_engine(Philox4x32& engine, uint64_t index) {
+    return engine.substream(index);
+}
+
+// The child takes the state over and the parent jumps 2^128 draws ahead.
+inline Xoshiro256 split_engine(Xoshiro256& engine, uint64_t) {
+    Xoshiro256 child = engine;
+    engine.jump();
+    return child;
+}
+
+// The child takes the state over and the parent advances 2^64 draws.
+inline Pcg64 split_engine(Pcg64& engine, uint64_t) {
+    Pcg64 child = engine;
+    engine.advance(Pcg64::uint128(1) << 64);
+    return child;
+}
+
+// The state is a single word, so the child is seeded with a whole draw.
+inline SplitMix64 split_engine(SplitMix64& engine, uint64_t) {
+    return SplitMix64(engine());
+}
+
+// The words left in the buffer of the parent are drawn by the parent only.
+template<typename Engine>
+inline BufferedBits<Engine> split_engine(BufferedBits<Engine>& bits, uint64_t index) {
+    return BufferedBits<Engine>(split_engine(bits.engine(), index));
+}
+
+// Color counts the solvers are compiled for.
+#define LINEARWANG_FOR_EACH_COLOR_COUNT(F) F(3) F(4) F(8)
+
+template<int Colors, typename Engine>
+class BasicColorGeneration {
 public:
-    ColorGeneration(unsigned seed, int bound): rng(new std::mt19937(seed)), b(bound){}
+    static_assert(Colors >= 3, "Brick Wang tiles need at least three colors");
+
+    typedef Engine engine_type;
 
-    inline int bound() const { return b; }
+    explicit BasicColorGeneration(unsigned seed): rng(seed){}
+    explicit BasicColorGeneration(const Engine& engine): rng(engine){}
+
+    // The solvers share one stream through references; a copy would silently fork it.
+    BasicColorGeneration(const BasicColorGeneration&) = delete;
+    BasicColorGeneration& operator=(const BasicColorGeneration&) = delete;
+
+    static constexpr int bound() { return Colors; }
 
     inline int pick_color() {
-        return std::uniform_int_distribution<int>(0, bound()-1)(*rng.get());
+        return draw_below(rng, bound());
+    }
+
+    // Uniform in [0, n).
+    inline int pick_below(int n) {
+        return draw_below(rng, n);
+    }
+
+    // Engine for an independent generation labelled by index, see split_engine.
+    inline Engine split(uint64_t index) {
+        return split_engine(rng, index);
     }
 
     inline int pick_different_color(int c) {
-        int r = std::uniform_int_distribution<int>(0, bound()-2)(*rng.get());
+        int r = draw_below(rng, bound()-1);
         if (r < c)
             return r;
         return r+1;
     }
 
     inline int pick_different_color(int c1, int c2) {
+        // With three colors the only color left is forced.
+        if (Colors == 3 && c1 != c2)
+            return 3 - c1 - c2;
         if (c1 == c2)
             return pick_different_color(c1);
         if (c2 < c1)
             std::swap(c1, c2);
-        int r = std::uniform_int_distribution<int>(0, bound()-3)(*rng.get());
+        int r = draw_below(rng, bound()-2);
         if (r < c1)
             return r;
         r += 1;
@@ -37,15 +130,49 @@ public:
         return r+1;
     }
 
+    // Colors the sides of t left at -1 so that t is a valid brick Wang tile, uniformly
+    // among the completions of t.
     void complete_tile(tile& t);
 
     double get() {
-        return std::uniform_real_distribution<>(0,1)(*rng.get());
+        return draw_unit(rng);
     }
 
 private:
-    std::shared_ptr<std::mt19937>(rng);
-    int b;
+    void complete_tile_by_draws(tile& t);
+    void complete_tile_by_table(tile& t);
+
+    Engine rng;
 };
 
+#ifdef LINEARWANG_BUFFERED_RNG
+typedef BufferedBits<std::mt19937> SerialEngine;
+#else
+typedef std::mt19937 SerialEngine;
+#endif
+
+// Single sequential stream, used by the serial solver. mt19937 is the default engine and
+// keeps the tilings of existing seeds; the 64-bit engines trade it for speed.
+template<int Colors>
+using ColorGeneration = BasicColorGeneration<Colors, SerialEngine>;
+template<int Colors>
+using Xoshiro256Generation = BasicColorGeneration<Colors, BufferedBits<Xoshiro256>>;
+template<int Colors>
+using Pcg64Generation = BasicColorGeneration<Colors, BufferedBits<Pcg64>>;
+template<int Colors>
+using SplitMix64Generation = BasicColorGeneration<Colors, BufferedBits<SplitMix64>>;
+
+// Counter-based streams derived from (seed, component, cell): the colors drawn for a
+// component do not depend on which thread solves it or when.
+template<int Colors>
+using StreamColorGeneration = BasicColorGeneration<Colors, BufferedBits<Philox4x32>>;
+
+// Engines the solvers are compiled for, each instantiated as BasicColorGeneration<Colors, Engine>.
+#define LINEARWANG_FOR_EACH_ENGINE(F, Colors) \
+    F(Colors, SerialEngine) \
+    F(Colors, BufferedBits<Xoshiro256>) \
+    F(Colors, BufferedBits<Pcg64>) \
+    F(Colors, BufferedBits<SplitMix64>) \
+    F(Colors, BufferedBits<Philox4x32>)
+
 #endif //LINEARWANG_WANG_H
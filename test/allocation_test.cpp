@@ -0,0 +1,131 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include "board.h"
+#include "cell_graph.h"
+#include "coloring.h"
+#include "components.h"
+#include "general.h"
+#include "wang.h"
+
+// Checks that once a board has been labelled and its cell graph built, solving its components
+// does not allocate: the serial solvers keep their stacks and cycle buffers from one component
+// to the next, so a second board of the same shape reuses the storage grown by the first.
+
+namespace {
+
+std::atomic<size_t> allocations(0);
+
+}
+
+void* operator new(size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what) {
+    if (!ok) {
+        std::cout<<"FAILED: "<<what<<std::endl;
+        ++failures;
+    }
+}
+
+void add_rectangle(Board& board, int i0, int j0, int i1, int j1) {
+    for (int j = j0; j <= j1; ++j)
+        for (int i = i0; i <= i1; ++i)
+            board.add_cell(i, j);
+}
+
+// A block with a tail, a ring of width one with branches inside and out, and a comb.
+Board fixture() {
+    Board board(64, 48);
+    add_rectangle(board, 2, 2, 9, 7);
+    add_rectangle(board, 10, 4, 14, 4);
+
+    add_rectangle(board, 20, 2, 35, 2);
+    add_rectangle(board, 20, 17, 35, 17);
+    add_rectangle(board, 20, 3, 20, 16);
+    add_rectangle(board, 35, 3, 35, 16);
+    add_rectangle(board, 27, 3, 27, 8);
+    add_rectangle(board, 36, 10, 40, 10);
+
+    add_rectangle(board, 2, 30, 30, 30);
+    for (int i = 4; i <= 28; i += 4)
+        add_rectangle(board, i, 31, i, 34);
+    return board;
+}
+
+// Colors the boundary and the exterior as the program does.
+Coloring exterior_coloring(Board& board) {
+    Coloring coloring(board.width(), board.height());
+    board.edge_iter([&board, &coloring](Edge e) { if (board.is_boundary_edge(e)) set_color(coloring, e, 0); });
+    board.outside_vertex_iter([&coloring](coord_type v){
+        set_color(coloring, left(v), 1);
+        set_color(coloring, right(v), 1);
+        set_color(coloring, top(v), v.second % 2 == 0 ? 0 : 2);
+        set_color(coloring, bottom(v), v.second % 2 == 0 ? 2 : 0);
+    });
+    return coloring;
+}
+
+// Solves the components of the fixture and returns the number of allocations made meanwhile.
+size_t solve_fixture(ColorGeneration<3>& gen, bool check_tiling) {
+    Board board = fixture();
+    Coloring coloring = exterior_coloring(board);
+    std::vector<Component> components = label_components(board);
+
+    if (check_tiling) {
+        bool block = false, cycle = false, tree = false;
+        for (const auto& component: components) {
+            block = block || component.has_block;
+            cycle = cycle || (component.cyclic && !component.has_block);
+            tree = tree || !component.cyclic;
+        }
+        check(block && cycle && tree, "the fixture has a block, a thin cycle and a tree");
+    }
+
+    CellGraph graph(board);
+    size_t before = allocations;
+    for (const auto& component: components)
+        complete_component(gen, board, graph, coloring, component);
+    size_t made = allocations - before;
+
+    if (check_tiling) {
+        bool valid = true;
+        board.vertex_iter([&coloring, &valid](coord_type c) {
+            tile t = get_tile(coloring, c);
+            for (int side = 0; side < 4; ++side)
+                valid = valid && t[side] >= 0 && t[side] < 3;
+            valid = valid && ((t[0] == t[2]) != (t[1] == t[3]));
+        });
+        check(valid, "every cell of the fixture holds a valid tile");
+    }
+    return made;
+}
+
+}
+
+int main() {
+    ColorGeneration<3> gen(1234);
+    solve_fixture(gen, false);
+    size_t made = solve_fixture(gen, true);
+    if (made != 0)
+        std::cout<<made<<" allocations while solving the components"<<std::endl;
+    check(made == 0, "solving the components of a labelled board does not allocate");
+    return failures == 0 ? 0 : 1;
+}
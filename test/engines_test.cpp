@@ -0,0 +1,86 @@
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include "engines.h"
+#include "philox.h"
+
+// Known-answer checks of the random engines against their reference implementations.
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what) {
+    if (!ok) {
+        std::cout<<"FAILED: "<<what<<std::endl;
+        ++failures;
+    }
+}
+
+template<typename Engine, size_t N>
+bool produces(Engine engine, const std::array<typename Engine::result_type, N>& expected) {
+    for (auto value: expected)
+        if (engine() != value)
+            return false;
+    return true;
+}
+
+}
+
+int main() {
+    // Vigna's splitmix64.c seeded with 1234567.
+    check(produces(SplitMix64(1234567), std::array<uint64_t, 5> {{
+            6457827717110365317ULL, 3203168211198807973ULL, 9817491932198370423ULL,
+            4593380528125082431ULL, 16408922859458223821ULL}}),
+          "SplitMix64 seeded with 1234567");
+
+    // pcg64_srandom_r(&rng, 42, 54) of the PCG C library, as in its pcg64-demo.
+    check(produces(Pcg64(42, 54), std::array<uint64_t, 6> {{
+            0x86b1da1d72062b68ULL, 0x1304aa46c9853d39ULL, 0xa3670e9e0dd50358ULL,
+            0xf9090e529a7dae00ULL, 0xc85b9fd837996f2cULL, 0x606121f8e3919196ULL}}),
+          "Pcg64 with initstate 42 and initseq 54");
+
+    // Advancing skips as many draws as made one by one.
+    for (unsigned delta: {1u, 7u, 1000u}) {
+        Pcg64 stepped(42, 54);
+        for (unsigned k = 0; k < delta; ++k)
+            stepped();
+        Pcg64 advanced(42, 54);
+        advanced.advance(delta);
+        check(stepped() == advanced(), "Pcg64 advance");
+    }
+
+    // A jump is a polynomial in the transition, so it commutes with a draw.
+    Xoshiro256 draw_then_jump(1234567);
+    Xoshiro256 jump_then_draw(1234567);
+    draw_then_jump();
+    draw_then_jump.jump();
+    jump_then_draw.jump();
+    jump_then_draw();
+    check(draw_then_jump() == jump_then_draw(), "Xoshiro256 jump commutes with a draw");
+
+    // Philox4x32-10 known answers of Random123.
+    typedef std::array<uint32_t, 4> Block;
+    check(Philox4x32::block(Block {{0, 0, 0, 0}}, {{0, 0}})
+          == Block {{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+          "Philox4x32-10 with zero counter and key");
+    check(Philox4x32::block(Block {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}}, {{0xffffffff, 0xffffffff}})
+          == Block {{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+          "Philox4x32-10 with all-ones counter and key");
+    check(Philox4x32::block(Block {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}}, {{0xa4093822, 0x299f31d0}})
+          == Block {{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}},
+          "Philox4x32-10 with the digits of pi");
+
+    // A substream keeps the key and component of its parent, whatever the parent drew.
+    Philox4x32 parent(0x123456789ULL, 3, 5);
+    for (int k = 0; k < 9; ++k)
+        parent();
+    Philox4x32 substream = parent.substream(9);
+    Philox4x32 direct(0x123456789ULL, 3, 9);
+    bool same = true;
+    for (int k = 0; k < 8; ++k)
+        same = same && substream() == direct();
+    check(same, "Philox4x32 substream");
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,206 @@
+#include <iostream>
+#include <random>
+#include <vector>
+#include "board.h"
+#include "cell_graph.h"
+#include "coloring.h"
+#include "components.h"
+#include "cycle_solver.h"
+#include "general.h"
+#include "thread_pool.h"
+#include "tree_solver.h"
+#include "wang.h"
+
+// Checks the parallel paths of the solvers, run on small inputs by lowering the thresholds
+// of the pool, against their serial counterparts and across thread counts.
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what) {
+    if (!ok) {
+        std::cout<<"FAILED: "<<what<<std::endl;
+        ++failures;
+    }
+}
+
+// Thresholds low enough that a few hundred cells make several tasks.
+ParallelThresholds small_thresholds() {
+    ParallelThresholds thresholds;
+    thresholds.cycle_length = 0;
+    thresholds.chain_block = 16;
+    thresholds.fork_size = 32;
+    thresholds.subtree_cells = 0;
+    thresholds.subtree_batch = 32;
+    return thresholds;
+}
+
+// Colors the boundary and the exterior as the program does.
+Coloring exterior_coloring(Board& board) {
+    Coloring coloring(board.width(), board.height());
+    board.edge_iter([&board, &coloring](Edge e) { if (board.is_boundary_edge(e)) set_color(coloring, e, 0); });
+    board.outside_vertex_iter([&coloring](coord_type v){
+        set_color(coloring, left(v), 1);
+        set_color(coloring, right(v), 1);
+        set_color(coloring, top(v), v.second % 2 == 0 ? 0 : 2);
+        set_color(coloring, bottom(v), v.second % 2 == 0 ? 2 : 0);
+    });
+    return coloring;
+}
+
+bool valid_tiling(Board& board, const Coloring& coloring) {
+    bool valid = true;
+    board.vertex_iter([&coloring, &valid](coord_type c) {
+        tile t = get_tile(coloring, c);
+        for (int side = 0; side < 4; ++side)
+            valid = valid && t[side] >= 0 && t[side] < 3;
+        valid = valid && ((t[0] == t[2]) != (t[1] == t[3]));
+    });
+    return valid;
+}
+
+bool same_colors(Board& board, const Coloring& a, const Coloring& b) {
+    bool same = true;
+    board.edge_iter([&a, &b, &same](Edge e) { same = same && lookup_color(a, e) == lookup_color(b, e); });
+    return same;
+}
+
+// Grows a tree of cells from the middle of the board: a cell is added only next to exactly
+// one cell of the tree, so the cells never close a cycle.
+Board random_tree(int size, size_t cells, unsigned seed) {
+    Board board(size, size);
+    std::mt19937 rng(seed);
+    std::vector<coord_type> tree {std::make_pair(size / 2, size / 2)};
+    std::vector<bool> in_tree(static_cast<size_t>(size * size), false);
+    auto at = [size, &in_tree](int i, int j) { return in_tree[static_cast<size_t>(j * size + i)]; };
+    in_tree[static_cast<size_t>((size / 2) * size + size / 2)] = true;
+    const int di[4] = {0, -1, 0, 1};
+    const int dj[4] = {1, 0, -1, 0};
+    while (tree.size() < cells) {
+        coord_type c = tree[rng() % tree.size()];
+        int side = static_cast<int>(rng() % 4);
+        int i = c.first + di[side];
+        int j = c.second + dj[side];
+        if (i < 1 || j < 1 || i > size - 2 || j > size - 2 || at(i, j))
+            continue;
+        int neighbors = 0;
+        for (int s = 0; s < 4; ++s)
+            neighbors += at(i + di[s], j + dj[s]) ? 1 : 0;
+        if (neighbors != 1)
+            continue;
+        in_tree[static_cast<size_t>(j * size + i)] = true;
+        tree.push_back(std::make_pair(i, j));
+    }
+    for (auto c: tree)
+        board.add_cell(c.first, c.second);
+    return board;
+}
+
+// Random straight and corner cells; the edges are not used by the propagation.
+CycleCells random_cells(size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    CycleCells types;
+    Edge unused(Orientation::H, 0, 0);
+    for (size_t k = 0; k < n; ++k) {
+        auto kind = rng() % 2 == 0 ? CycleCells::Straight : CycleCells::Corner;
+        types.push_back(kind, static_cast<int>(rng() % 3), static_cast<int>(rng() % 3), unused, unused);
+    }
+    return types;
+}
+
+// The scan draws one choice per cell in chain order, then each cell maps its input color
+// with step: a serial fold of step over the same draws gives the colors to expect.
+void check_chain_scan(unsigned threads) {
+    const size_t begin = 2;
+    CycleCells types = random_cells(1000, threads);
+    std::vector<size_t> primitive;
+    for (size_t k = 0; k < types.size(); ++k)
+        if (!types.is_pass(k))
+            primitive.push_back(k);
+
+    CycleCells expected = types;
+    ColorGeneration<3> reference(99);
+    int color = 1;
+    for (size_t index = begin; index < primitive.size(); ++index) {
+        size_t k = primitive[index];
+        int r = reference.pick_below(2);
+        expected.in_color[k] = static_cast<int8_t>(color);
+        color = expected.step(k, color, r);
+        expected.out_color[k] = static_cast<int8_t>(color);
+    }
+
+    ThreadPool pool(threads, small_thresholds());
+    ColorGeneration<3> gen(99);
+    int out = propagate_chain(gen, &pool, types, primitive, begin, 1);
+
+    check(out == color, "the parallel chain scan leaves the color of the serial fold");
+    check(types.in_color == expected.in_color && types.out_color == expected.out_color,
+          "the parallel chain scan colors the cells as the serial fold");
+    check(gen.pick_below(1 << 20) == reference.pick_below(1 << 20),
+          "the parallel chain scan draws as many choices as the serial fold");
+}
+
+// The contraction of a tree writes the constraints of the serial sweep from the leaves.
+void check_tree_contraction(unsigned threads) {
+    Board board = random_tree(64, 1500, 7);
+    Coloring coloring = exterior_coloring(board);
+    std::vector<Component> components = label_components(board);
+    check(components.size() == 1 && !components[0].cyclic, "the random tree is one acyclic component");
+    CellGraph graph(board);
+
+    ThreadPool pool(threads, small_thresholds());
+    check(tree_edge_constraints<3>(board, graph, coloring, components[0].seed, &pool)
+          == tree_edge_constraints<3>(board, graph, coloring, components[0].seed, nullptr),
+          "the tree contraction writes the constraints of the serial sweep");
+}
+
+// Large subtrees are colored as tasks drawing from streams of their own: the tiling is valid
+// and the same whatever the number of threads.
+void check_tree_solution() {
+    Board one = random_tree(64, 1500, 11);
+    Board three = random_tree(64, 1500, 11);
+    Coloring coloring_one = exterior_coloring(one);
+    Coloring coloring_three = exterior_coloring(three);
+    complete_coloring_parallel<3>(1234, 1, one, coloring_one, small_thresholds());
+    complete_coloring_parallel<3>(1234, 3, three, coloring_three, small_thresholds());
+    check(valid_tiling(one, coloring_one), "the tree solved in parallel holds a valid tiling");
+    check(same_colors(one, coloring_one, coloring_three), "the tree is tiled the same with 1 and 3 threads");
+}
+
+
+// A random tree with a 2x2 block at its root: the subtrees hanging from the block are
+// completed in batches, each drawing from a stream of its own.
+Board tree_with_block(unsigned seed) {
+    Board board = random_tree(64, 1500, seed);
+    for (int k = 0; k < 4; ++k)
+        board.add_cell(32 + k % 2, 32 + k / 2);
+    return board;
+}
+
+void check_subtree_batches() {
+    Board probe = tree_with_block(5);
+    std::vector<Component> components = label_components(probe);
+    check(components.size() == 1 && components[0].has_block, "the tree with a block is one component with a block");
+
+    Board one = tree_with_block(5);
+    Board three = tree_with_block(5);
+    Coloring coloring_one = exterior_coloring(one);
+    Coloring coloring_three = exterior_coloring(three);
+    complete_coloring_parallel<3>(1234, 1, one, coloring_one, small_thresholds());
+    complete_coloring_parallel<3>(1234, 3, three, coloring_three, small_thresholds());
+    check(valid_tiling(one, coloring_one), "the subtrees completed in batches hold a valid tiling");
+    check(same_colors(one, coloring_one, coloring_three), "the subtrees are tiled the same with 1 and 3 threads");
+}
+
+}
+
+int main() {
+    check_chain_scan(1);
+    check_chain_scan(3);
+    check_tree_contraction(1);
+    check_tree_contraction(3);
+    check_tree_solution();
+    check_subtree_batches();
+    return failures == 0 ? 0 : 1;
+}